@@ -0,0 +1,199 @@
+// Copyright (c) 2014-2019 Robert A. Alfieri
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+#include "Node.h"
+#include "Misc.h"
+#include <new>
+#include <sys/mman.h>
+
+class nArena::Map
+{
+public:
+    void *  addr;
+    size_t  len;
+    nArena *inner;                              // arena placed inside the mapping, if any
+    Map *   next;
+};
+
+//---------------------------------------
+// Arena Implementation
+//
+// Blocks are chained through their first 8 bytes, only so they can be 
+// freed.  Requests bigger than a quarter block get a block of their own 
+// so they don't waste the rest of the current one.
+//---------------------------------------
+char * nArena::block_new( size_t len )
+{
+    char * block = static_cast<char *>( malloc( sizeof( char * ) + len ) );
+    if ( block == nullptr ) error( "arena out of memory" );
+    *reinterpret_cast<char **>( block ) = this->blocks;
+    this->blocks = block;
+    this->total += sizeof( char * ) + len;
+    return block + sizeof( char * );
+}
+
+//---------------------------------------
+// Arena Constructor
+//---------------------------------------
+nArena::nArena( int block_len )
+{
+    this->block_len = block_len;
+    this->blocks = nullptr;
+    this->pos = nullptr;
+    this->end = nullptr;
+    this->total = 0;
+    this->maps = nullptr;
+}
+
+//---------------------------------------
+// Arena Destructor
+//---------------------------------------
+nArena::~nArena( void )
+{
+    while( this->blocks != nullptr ) 
+    {
+        char * prev = *reinterpret_cast<char **>( this->blocks );
+        free( this->blocks );
+        this->blocks = prev;
+    }
+    while( this->maps != nullptr )
+    {
+        Map * next = this->maps->next;
+        if ( this->maps->inner != nullptr ) this->maps->inner->~nArena();
+        munmap( this->maps->addr, this->maps->len );
+        delete this->maps;
+        this->maps = next;
+    }
+}
+
+//---------------------------------------
+// Arena Allocation
+//---------------------------------------
+void * nArena::alloc( size_t len )
+{
+    len = (len + 7) & ~size_t( 7 );
+    if ( len > size_t( this->end - this->pos ) ) {
+        if ( len > size_t( this->block_len >> 2 ) ) return this->block_new( len );
+        this->pos = this->block_new( this->block_len );
+        this->end = this->pos + this->block_len;
+    }
+    void * p = this->pos;
+    this->pos += len;
+    return p;
+}
+
+nStr nArena::strdup( nStr s )
+{
+    size_t len = strlen( s ) + 1;
+    char * p = static_cast<char *>( this->alloc( len ) );
+    memcpy( p, s, len );
+    return p;
+}
+
+Hash * nArena::hash_new( bool shaped )
+{
+    return new( this->alloc( sizeof( Hash ) ) ) Hash( shaped, this );
+}
+
+List * nArena::list_new( void )
+{
+    return new( this->alloc( sizeof( List ) ) ) List( this );
+}
+
+List * nArena::list_new( const nVal * vals, int cnt )
+{
+    return new( this->alloc( sizeof( List ) ) ) List( vals, cnt, this );
+}
+
+long nArena::bytes( void )
+{
+    return this->total;
+}
+
+//---------------------------------------
+// Arena Mark and Release
+//---------------------------------------
+nArena::Mark nArena::mark( void )
+{
+    Mark m;
+    m.blocks = this->blocks;
+    m.pos = this->pos;
+    m.end = this->end;
+    m.total = this->total;
+    return m;
+}
+
+void nArena::release( const Mark& m )
+{
+    while( this->blocks != m.blocks ) 
+    {
+        char * prev = *reinterpret_cast<char **>( this->blocks );
+        free( this->blocks );
+        this->blocks = prev;
+    }
+    this->pos = m.pos;
+    this->end = m.end;
+    this->total = m.total;
+}
+
+//---------------------------------------
+// Adopting Another Arena
+//
+// other's blocks count as allocated now, so they go on top of the chain,
+// and a release() to a mark() taken before adopt() frees them along with
+// everything else allocated since.  The current block stays current for
+// alloc() even though it is no longer on top.
+//---------------------------------------
+void nArena::adopt( nArena& other )
+{
+    if ( other.blocks != nullptr ) {
+        char * tail = other.blocks;
+        while( *reinterpret_cast<char **>( tail ) != nullptr ) tail = *reinterpret_cast<char **>( tail );
+        *reinterpret_cast<char **>( tail ) = this->blocks;
+        this->blocks = other.blocks;
+    }
+    while( other.maps != nullptr ) 
+    {
+        Map * next = other.maps->next;
+        other.maps->next = this->maps;
+        this->maps = other.maps;
+        other.maps = next;
+    }
+    this->total += other.total;
+    other.blocks = nullptr;
+    other.pos = nullptr;
+    other.end = nullptr;
+    other.total = 0;
+}
+
+//---------------------------------------
+// Adopted Mappings
+//
+// Kept apart from the blocks so that release() leaves them alone.
+//---------------------------------------
+void nArena::map_adopt( void * addr, size_t len, nArena * inner )
+{
+    Map * m = new Map;
+    m->addr = addr;
+    m->len = len;
+    m->inner = inner;
+    m->next = this->maps;
+    this->maps = m;
+}
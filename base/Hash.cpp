@@ -21,36 +21,252 @@
 #include "Hash.h"
 #include "assert.h"
 #include "Misc.h"
+#include <stdint.h>
 
 #undef dprintf
 #define dprintf if ( 0 ) printf
 
 //---------------------------------------
 // STATIC: String to Property ID 
+//
+// Interning table keyed on string contents.  It is safe to call str_to_id()
+// and id_to_str() from any number of threads at once:
+//
+//     - The table is split into shards selected by the top bits of the hash.
+//       Each shard has its own open-addressed probe table of packed (hash, id+1)
+//       slots, its own string arena, and its own mutex.
+//     - Lookups of existing strings take no locks.  Probe tables are published
+//       with release stores and are never freed once published, so a reader
+//       that raced with a resize is still looking at valid (if stale) memory.
+//       A miss is retried under the shard lock before inserting.
+//     - Ids come from one atomic counter, so they are dense, and id_to_str()
+//       indexes a chunked array whose chunks never move.
+//     - The well-known names from Node.h are interned first, before anyone
+//       else can get in, so they get ids 0, 1, 2, ... in declaration order.
+//
+// str_pooled() values live in a second pool of the same kind, whose 
+// numbers are private, so value strings never use up property ids.  
+// Neither pool is ever freed.
 //---------------------------------------
-#include <map>
-static std::map<nStr, int> str_id_map;
-static std::map<int, nStr> id_str_map;
-static int                 str_id_next = 0;
+#include <atomic>
+#include <mutex>
 
-int Hash::str_to_id( nStr s )
+const int STR_SHARD_CNT         = 16;
+const int STR_SHARD_SHIFT       = 28;                   // top 4 bits of the hash select the shard
+const int STR_INIT_SLOT_CNT     = 256;                  // per shard
+const int STR_ARENA_BLOCK_LEN   = 64*1024;
+const int STR_CHUNK_SHIFT       = 12;
+const int STR_CHUNK_LEN         = 1 << STR_CHUNK_SHIFT; // ids per chunk
+const int STR_CHUNK_CNT         = 1 << 16;              // max chunks
+
+class StrTable
+{
+public:
+    int                         mask;                   // allocated slots-1
+    std::atomic<uint64_t> *     slots;                  // (hash << 32) | (id+1), 0 means unused
+};
+
+class StrShard
+{
+public:
+    std::mutex                  mutex;                  // held by inserters only
+    std::atomic<StrTable *>     table;                  // current probe table
+    int                         count;                  // ids in this shard
+    char *                      arena;                  // current arena block
+    int                         arena_pos;              // bytes used in current block
+    int                         arena_len;              // bytes allocated in current block
+};
+
+class StrPool
+{
+public:
+    StrShard                    shards[STR_SHARD_CNT];
+    std::atomic<nStr *>         id_chunks[STR_CHUNK_CNT];   // string of each id
+    std::atomic<int>            id_next;                // ids handed out so far
+};
+
+static StrPool                  str_ids;                // property names
+static StrPool                  str_vals;               // Hash::str_pooled() values
+
+static inline uint32_t str_hash( nStr s, int& len )
+{
+    //---------------------------------------
+    // FNV-1a, computing the length along the way.
+    //---------------------------------------
+    uint32_t h = 2166136261u;
+    const char * p = s;
+    for( ; *p != '\0'; p++ )
+    {
+        h ^= uint8_t( *p );
+        h *= 16777619u;
+    }
+    len = p - s;
+    return h;
+}
+
+static inline nStr * str_id_slot( StrPool& pool, int id, bool alloc )
 {
     //---------------------------------------
-    // See if a mapping already exists by iterating 
-    // through all values because we can't use the string pointer (due to duplicates).
-    // TODO: this is way too slow
+    // Returns the id's entry in its chunk, allocating the chunk
+    // if necessary.  Concurrent allocators race with a CAS.
     //---------------------------------------
-    for( std::map<nStr, int>::iterator it = str_id_map.begin(); it != str_id_map.end(); it++ )
+    int c = id >> STR_CHUNK_SHIFT;
+    dassert( c < STR_CHUNK_CNT );
+    nStr * chunk = pool.id_chunks[c].load( std::memory_order_acquire );
+    if ( chunk == nullptr ) {
+        dassert( alloc );
+        nStr * new_chunk = new nStr[STR_CHUNK_LEN];
+        if ( pool.id_chunks[c].compare_exchange_strong( chunk, new_chunk, std::memory_order_acq_rel ) ) {
+            chunk = new_chunk;
+        } else {
+            delete[] new_chunk;  // someone else won, chunk now holds theirs
+        }
+    }
+    return &chunk[id & (STR_CHUNK_LEN-1)];
+}
+
+static int str_find( StrPool& pool, StrTable * table, nStr s, uint32_t h, int& i )
+{
+    //---------------------------------------
+    // Probe until we hit the string or an unused slot.
+    // Leaves i at the slot where we stopped.
+    //---------------------------------------
+    i = h & table->mask;
+    for( ;; )
+    {
+        uint64_t slot = table->slots[i].load( std::memory_order_acquire );
+        if ( slot == 0 ) return -1;
+        if ( uint32_t( slot >> 32 ) == h ) {
+            int id = int( uint32_t( slot ) ) - 1;
+            if ( strcmp( s, *str_id_slot( pool, id, false ) ) == 0 ) return id;
+        }
+        i = (i+1) & table->mask;
+    }
+}
+
+static StrTable * str_table_alloc( int slot_cnt )
+{
+    StrTable * table = new StrTable;
+    table->mask = slot_cnt-1;
+    table->slots = new std::atomic<uint64_t>[slot_cnt];
+    for( int i = 0; i < slot_cnt; i++ )
     {
-        if ( strcmp( s, it->first ) == 0 ) {
-            return it->second;  // id
+        table->slots[i].store( 0, std::memory_order_relaxed );
+    }
+    return table;
+}
+
+static StrTable * str_table_resize( StrShard * shard, StrTable * old_table )
+{
+    //---------------------------------------
+    // Called with the shard lock held.  The old table is deliberately leaked
+    // because lock-free readers may still be probing it.  Tables double, so
+    // the retired ones add up to less than the live one.
+    //---------------------------------------
+    StrTable * table = str_table_alloc( (old_table->mask+1) << 1 );
+    for( int i = 0; i <= old_table->mask; i++ )
+    {
+        uint64_t slot = old_table->slots[i].load( std::memory_order_relaxed );
+        if ( slot == 0 ) continue;
+        int j = uint32_t( slot >> 32 ) & table->mask;
+        while( table->slots[j].load( std::memory_order_relaxed ) != 0 ) 
+        {
+            j = (j+1) & table->mask;
         }
+        table->slots[j].store( slot, std::memory_order_relaxed );
     }
-        
-    const char * s_dup = strdup( s );
-    str_id_map[s_dup] = str_id_next;
-    id_str_map[str_id_next] = s_dup;
-    return str_id_next++;
+    shard->table.store( table, std::memory_order_release );
+    return table;
+}
+
+static nStr str_arena_dup( StrShard * shard, nStr s, int len )
+{
+    //---------------------------------------
+    // Called with the shard lock held.  Strings are never freed, so just 
+    // bump-allocate out of big blocks.  Oversized strings get a block of their own.
+    //---------------------------------------
+    if ( (shard->arena_pos + len + 1) > shard->arena_len ) {
+        shard->arena_len = (len+1) > STR_ARENA_BLOCK_LEN ? (len+1) : STR_ARENA_BLOCK_LEN;
+        shard->arena = new char[shard->arena_len];
+        shard->arena_pos = 0;
+    }
+    char * d = &shard->arena[shard->arena_pos];
+    memcpy( d, s, len+1 );
+    shard->arena_pos += len+1;
+    return d;
+}
+
+static int str_intern( StrPool& pool, nStr s )
+{
+    int len;
+    uint32_t h = str_hash( s, len );
+    StrShard * shard = &pool.shards[h >> STR_SHARD_SHIFT];
+
+    //---------------------------------------
+    // Fast path: no locks.
+    //---------------------------------------
+    int i;
+    StrTable * table = shard->table.load( std::memory_order_acquire );
+    if ( table != nullptr ) {
+        int id = str_find( pool, table, s, h, i );
+        if ( id >= 0 ) return id;
+    }
+
+    //---------------------------------------
+    // Slow path: lock the shard and look again in case someone
+    // else inserted it (or resized) in the meantime.
+    //---------------------------------------
+    std::lock_guard<std::mutex> lock( shard->mutex );
+    table = shard->table.load( std::memory_order_relaxed );
+    if ( table == nullptr ) {
+        table = str_table_alloc( STR_INIT_SLOT_CNT );
+        shard->table.store( table, std::memory_order_release );
+    }
+    int id = str_find( pool, table, s, h, i );
+    if ( id >= 0 ) return id;
+
+    //---------------------------------------
+    // New string.  Keep the table at most half full.  
+    // The id->str entry must be filled in before the slot is published.
+    //---------------------------------------
+    if ( (shard->count+1) > ((table->mask+1) >> 1) ) {
+        table = str_table_resize( shard, table );
+        str_find( pool, table, s, h, i );
+    }
+    id = pool.id_next.fetch_add( 1, std::memory_order_relaxed );
+    *str_id_slot( pool, id, true ) = str_arena_dup( shard, s, len );
+    shard->count++;
+    table->slots[i].store( (uint64_t( h ) << 32) | uint32_t( id+1 ), std::memory_order_release );
+    return id;
+}
+
+static bool str_seed( void )
+{
+    #define NODE_ID_STR( name ) #name,
+    static const char * const names[] = { NODE_WELL_KNOWN_IDS( NODE_ID_STR ) };
+    #undef NODE_ID_STR
+
+    for( int id = 0; id < Hash::id_well_known_cnt; id++ )
+    {
+        int got = str_intern( str_ids, names[id] );
+        dassert( got == id );
+    }
+    return true;
+}
+
+static inline void str_seed_once( void )
+{
+    //---------------------------------------
+    // Function-local static, so other threads wait for the seeding to finish.
+    //---------------------------------------
+    static bool seeded = str_seed();
+    (void)seeded;
+}
+
+int Hash::str_to_id( nStr s )
+{
+    str_seed_once();
+    return str_intern( str_ids, s );
 }
 
 nStr Hash::id_to_str( int id )
@@ -58,65 +274,189 @@ nStr Hash::id_to_str( int id )
     //---------------------------------------
     // Mapping better exist.
     //---------------------------------------
-    return id_str_map[id];
+    str_seed_once();
+    dassert( id >= 0 && id < str_ids.id_next.load( std::memory_order_relaxed ) );
+    return *str_id_slot( str_ids, id, false );
+}
+
+nStr Hash::str_pooled( nStr s )
+{
+    return *str_id_slot( str_vals, str_intern( str_vals, s ), false );
 }
 
 //---------------------------------------
-// Hash Entry
+// Id Group Matching
+//
+// Compares 8 consecutive ids against one id at a time and returns a bit per
+// lane, using AVX2 or SSE2 when the compiler allows, otherwise plain C.
+// The default build has SSE2 only; "make AVX2=1" enables AVX2.
 //---------------------------------------
-class Entry 
+#if defined( __AVX2__ ) || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+const int ID_GROUP_LEN = 8;
+
+static inline unsigned ids_match( const int * ids, int id, unsigned& empty_mask )
 {
-public:
-    int   id;
-    nKind kind;
-    union
+#if defined( __AVX2__ )
+    __m256i g = _mm256_loadu_si256( reinterpret_cast<const __m256i *>( ids ) );
+    empty_mask = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( g, _mm256_set1_epi32( -1 ) ) ) );
+    return       _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpeq_epi32( g, _mm256_set1_epi32( id ) ) ) );
+#elif defined( __SSE2__ )
+    __m128i lo = _mm_loadu_si128( reinterpret_cast<const __m128i *>( ids ) );
+    __m128i hi = _mm_loadu_si128( reinterpret_cast<const __m128i *>( ids+4 ) );
+    __m128i e  = _mm_set1_epi32( -1 );
+    __m128i m  = _mm_set1_epi32( id );
+    empty_mask = _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( lo, e ) ) ) | 
+                 (_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( hi, e ) ) ) << 4);
+    return       _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( lo, m ) ) ) | 
+                 (_mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( hi, m ) ) ) << 4);
+#else
+    unsigned match_mask = 0;
+    empty_mask = 0;
+    for( int j = 0; j < ID_GROUP_LEN; j++ )
     {
-        nInt          i;
-        nFlt          f;
-        nStr          s;
-        Hash *        hp;
-        List *        lp;
-    } u;
-};
+        if ( ids[j] == id ) match_mask |= 1 << j;
+        if ( ids[j] == -1 ) empty_mask |= 1 << j;
+    }
+    return match_mask;
+#endif
+}
+
+//---------------------------------------
+// Hash Implementation
+//
+// Small hashes (up to INLINE_CNT properties) keep their ids and values in
+// arrays inside the Hash object, in insertion order, with unused ids set to -1.
+// INLINE_CNT == ID_GROUP_LEN, so a lookup is a single group compare and a 
+// small hash never touches the heap.
+//
+// A shaped small hash doesn't keep its own ids.  It points to an nShape that
+// holds the ids in order and is shared by every hash that got the same keys
+// in the same order.  Records with one layout then share one hot ids array,
+// and an nProp that remembers (shape, slot) turns a lookup into a compare.
+//
+// Once that overflows, the properties move to a heap-allocated open-addressed
+// table with Robin Hood linear probing.  Ids are already dense and unique, so
+// an id's home slot is just (id & mask) and the probe distance of any entry can
+// be recomputed from its id; nothing extra is stored.
+//
+// Ids and values live in separate parallel arrays.  Probing only touches the
+// compact ids array, ID_GROUP_LEN slots at a time, and the values array is 
+// touched once, on a hit.  The ids array has ID_GROUP_LEN-1 extra slots at 
+// the end that mirror the first slots so a group never has to wrap.
+//
+// On insert, an entry that is closer to its home slot than the one being
+// inserted gives up its slot, which keeps probe lengths short and lets
+// lookups stop as soon as they pass an entry closer to home than they are.
+// On remove, the following entries of the cluster shift back one slot 
+// (backward-shift deletion), so there are no tombstones.
+//---------------------------------------
+static_assert( ID_GROUP_LEN == 8, "inline hash search assumes one group" );
 
-class Hash::Impl
+//---------------------------------------
+// Shapes
+//
+// Shapes form a tree rooted at the empty shape; adding id to a shape moves to
+// the child for that id, creating it the first time.  Children are found 
+// without locks, and created under shape_mutex and published with a release 
+// store.  Shapes are never freed.
+//---------------------------------------
+class nShape
 {
 public:
-    int     count;               // entries used
-    int     mask;                // allocated entries-1
-    Entry * entries;             // array of allocated entries
+    int                     ids[ID_GROUP_LEN];      // ids in order, -1 past the end
+    int                     cnt;                    // number of ids
+    int                     last_id;                // id that was added to the parent to get here
+    std::atomic<nShape *>   first_child;            // transitions, newest first
+    nShape *                next_sibling;           // immutable once published
+};
+
+static nShape       shape_root = { { -1, -1, -1, -1, -1, -1, -1, -1 }, 0, -1, { nullptr }, nullptr };
+static std::mutex   shape_mutex;
 
-    inline Entry * get( int id, nKind kind = UNDEF )
+static inline nShape * shape_child_find( nShape * shape, int id )
+{
+    for( nShape * c = shape->first_child.load( std::memory_order_acquire ); c != nullptr; c = c->next_sibling )
     {
-        //---------------------------------------
-        // Hash to proper starting entry, then increment from there.
-        //---------------------------------------
-        dassert( id >= 0 );
-        int i = id & this->mask;
-        Entry * e = &this->entries[i];
-        for( int j = 0; j <= this->mask; j++ )
-        {
-            if( e->id == id ) {
-                if ( kind != UNDEF && kind != e->kind ) {
-                    printf( "ERROR: wanted %s id=%d kind=%d got e->id=%d e->kind=%d\n", Hash::id_to_str( id ), id, kind, e->id, e->kind );
-                    my_exit( 1 );
-                }
-                dprintf( "get() found entry i=%d id=%d kind=%d\n", i, id, kind );
-                return e; // found
-            } 
-
-            if ( e->id == -1 ) {
-                break;    // no possibility, so stop here
-            }
+        if ( c->last_id == id ) return c;
+    }
+    return nullptr;
+}
 
-            if( i == this->mask ) {
-                i = 0;
-                e = &this->entries[0];
-            } else {
-                i++;
-                e++;
-            }
-        }
+static nShape * shape_add( nShape * shape, int id )
+{
+    dassert( shape->cnt < ID_GROUP_LEN );
+    nShape * child = shape_child_find( shape, id );
+    if ( child != nullptr ) return child;
+
+    std::lock_guard<std::mutex> lock( shape_mutex );
+    child = shape_child_find( shape, id );
+    if ( child != nullptr ) return child;
+
+    child = new nShape;
+    memcpy( child->ids, shape->ids, sizeof( child->ids ) );
+    child->ids[shape->cnt] = id;
+    child->cnt = shape->cnt + 1;
+    child->last_id = id;
+    child->first_child.store( nullptr, std::memory_order_relaxed );
+    child->next_sibling = shape->first_child.load( std::memory_order_relaxed );
+    shape->first_child.store( child, std::memory_order_release );
+    return child;
+}
+
+inline int Hash::slot_dist( int id, int i )
+{
+    return (i - id) & this->mask;
+}
+
+inline void Hash::slot_id_set( int i, int id )
+{
+    //---------------------------------------
+    // Keep the mirrored tail up to date.  Small tables
+    // are mirrored more than once.
+    //---------------------------------------
+    this->ids[i] = id;
+    for( int k = i; k < (ID_GROUP_LEN-1); k += this->mask+1 )
+    {
+        this->ids[this->mask+1+k] = id;
+    }
+}
+
+inline int Hash::slot_find( int id )
+{
+    //---------------------------------------
+    // Returns slot index or -1.
+    //
+    // Ids are unique, so any match in the group is the one.  Otherwise
+    // stop at a free slot, or when the last slot of the group holds an entry
+    // closer to its home than we are to ours (Robin Hood invariant).
+    //---------------------------------------
+    dassert( id >= 0 );
+    unsigned empty_mask;
+    if ( this->mask < 0 ) {
+        unsigned match_mask = ids_match( this->ids, id, empty_mask );
+        return (match_mask != 0) ? __builtin_ctz( match_mask ) : -1;
+    }
+
+    int i = id & this->mask;
+    for( int d = 0; ; d += ID_GROUP_LEN )
+    {
+        unsigned match_mask = ids_match( &this->ids[i], id, empty_mask );
+        if ( match_mask != 0 ) return (i + __builtin_ctz( match_mask )) & this->mask;
+        if ( empty_mask != 0 ) return -1;
+
+        int last = (i + ID_GROUP_LEN-1) & this->mask;
+        if ( this->slot_dist( this->ids[last], last ) < (d + ID_GROUP_LEN-1) ) return -1;
+        i = (last+1) & this->mask;
+    }
+}
+
+inline nVal * Hash::val_get( int id, nKind kind )
+{
+    int i = this->slot_find( id );
+    if ( i < 0 ) {
         if ( kind != UNDEF ) {
             printf( "ERROR: wanted (%s) id=%d kind=%d, did not find entry\n", Hash::id_to_str( id ), id, kind );
             my_exit( 1 );
@@ -124,79 +464,293 @@ public:
         return nullptr;
     }
 
-    Entry * set( int id, int recursion = 0 )
+    nVal * v = &this->vals[i];
+    if ( kind != UNDEF && kind != v->kind() ) {
+        printf( "ERROR: wanted %s id=%d kind=%d got kind=%d\n", Hash::id_to_str( id ), id, kind, v->kind() );
+        my_exit( 1 );
+    }
+    dprintf( "get() found entry i=%d id=%d kind=%d\n", i, id, kind );
+    return v;
+}
+
+inline nVal * Hash::val_get( nProp& p, nKind kind )
+{
+    //---------------------------------------
+    // Shaped hashes check the inline cache first and refill it on a miss.
+    //---------------------------------------
+    if ( this->mask == MASK_SHAPED ) {
+        if ( this->shape != p.shape ) {
+            int i = this->slot_find( p.id );
+            if ( i >= 0 ) {
+                p.shape = this->shape;
+                p.slot  = i;
+            }
+        }
+        if ( this->shape == p.shape ) {
+            nVal * v = &this->vals[p.slot];
+            if ( kind != UNDEF && kind != v->kind() ) {
+                printf( "ERROR: wanted %s id=%d kind=%d got kind=%d\n", Hash::id_to_str( p.id ), p.id, kind, v->kind() );
+                my_exit( 1 );
+            }
+            return v;
+        }
+    }
+    return this->val_get( p.id, kind );
+}
+
+nVal * Hash::slot_insert( int id, const nVal& val )
+{
+    //---------------------------------------
+    // Table mode only.  Id must not already be present and there must be 
+    // a free slot.  Returns the value slot that id ended up in.
+    //---------------------------------------
+    int     carry_id  = id;
+    nVal    carry_val = val;
+    nVal *  placed    = nullptr;
+    int i = id & this->mask;
+    for( int d = 0; ; d++ )
+    {
+        int e_id = this->ids[i];
+        if ( e_id == -1 ) {
+            this->slot_id_set( i, carry_id );
+            this->vals[i] = carry_val;
+            return (placed != nullptr) ? placed : &this->vals[i];
+        }
+
+        int e_d = this->slot_dist( e_id, i );
+        if ( e_d < d ) {
+            //---------------------------------------
+            // Steal from the rich: e is closer to home than carry.
+            //---------------------------------------
+            nVal e_val = this->vals[i];
+            this->slot_id_set( i, carry_id );
+            this->vals[i] = carry_val;
+            carry_id  = e_id;
+            carry_val = e_val;
+            d = e_d;
+            if ( placed == nullptr ) placed = &this->vals[i];
+        }
+        i = (i+1) & this->mask;
+    }
+}
+
+void Hash::table_alloc( int cnt )
+{
+    this->mask = cnt-1;
+    if ( this->arena != nullptr ) {
+        this->ids = static_cast<int *>( this->arena->alloc( (cnt + ID_GROUP_LEN-1) * sizeof( int ) ) );
+        this->vals = static_cast<nVal *>( this->arena->alloc( cnt * sizeof( nVal ) ) );
+    } else {
+        this->ids = new int[cnt + ID_GROUP_LEN-1];
+        this->vals = new nVal[cnt];
+    }
+    for( int i = 0; i < (cnt + ID_GROUP_LEN-1); i++ )
+    {
+        this->ids[i] = -1;
+    }
+}
+
+static std::atomic<long> hash_resize_total( 0 );
+
+void Hash::table_rebuild( int cnt )
+{
+    //---------------------------------------
+    // Moves all entries into a new table of cnt slots, or back 
+    // into the object if cnt is 0.  Re-inserts directly, no set().
+    //---------------------------------------
+    if ( this->mask == MASK_SHAPED ) this->shape_leave();
+    bool was_table = this->mask >= 0;
+    int old_cnt = was_table ? (this->mask+1) : INLINE_CNT;
+    int * old_ids = this->ids;
+    nVal * old_vals = this->vals;
+    dprintf( "rebuild from %d to %d\n", old_cnt, cnt );
+    hash_resize_total.fetch_add( 1, std::memory_order_relaxed );
+    if ( cnt == 0 ) {
+        dassert( was_table && this->count <= INLINE_CNT );
+        this->mask = MASK_INLINE;
+        this->ids = this->inline_ids;
+        this->vals = this->inline_vals;
+        int j = 0;
+        for( int i = 0; i < old_cnt; i++ )
+        {
+            if ( old_ids[i] == -1 ) continue;
+            this->inline_ids[j] = old_ids[i];
+            this->inline_vals[j] = old_vals[i];
+            j++;
+        }
+        for( ; j < INLINE_CNT; j++ ) 
+        {
+            this->inline_ids[j] = -1;
+        }
+    } else {
+        this->table_alloc( cnt );
+        for( int i = 0; i < old_cnt; i++ )
+        {
+            if ( old_ids[i] != -1 ) this->slot_insert( old_ids[i], old_vals[i] );
+        }
+    }
+    if ( was_table && this->arena == nullptr ) {
+        delete[] old_ids;
+        delete[] old_vals;
+    }
+}
+
+int Hash::table_cnt( int cnt )
+{
+    //---------------------------------------
+    // Smallest table that holds cnt entries at most 3/4 full.
+    //---------------------------------------
+    int table_cnt = INLINE_CNT << 1;
+    while( cnt*4 > table_cnt*3 ) 
+    {
+        table_cnt <<= 1;
+    }
+    return table_cnt;
+}
+
+void Hash::shape_leave( void )
+{
+    //---------------------------------------
+    // Copy the shared ids into the object.  inline_ids overlays shape.
+    //---------------------------------------
+    const int * shape_ids = this->shape->ids;
+    memmove( this->inline_ids, shape_ids, sizeof( this->inline_ids ) );
+    this->ids = this->inline_ids;
+    this->mask = MASK_INLINE;
+}
+
+void Hash::ids_remap( const int * id_map )
+{
+    //---------------------------------------
+    // For hashes that came from another process (see NodeImage.cpp).
+    // Inline ids keep their order.  A table is refilled in place,
+    // since where an entry goes depends on its id.
+    //---------------------------------------
+    if ( this->mask == MASK_SHAPED ) this->shape_leave();
+    if ( this->mask < 0 ) {
+        for( int i = 0; i < this->count; i++ )
+        {
+            this->ids[i] = id_map[this->ids[i]];
+        }
+        return;
+    }
+
+    int cnt = this->mask+1;
+    int * old_ids = new int[cnt];
+    nVal * old_vals = new nVal[cnt];
+    memcpy( old_ids, this->ids, cnt * sizeof( int ) );
+    memcpy( static_cast<void *>( old_vals ), this->vals, cnt * sizeof( nVal ) );
+    for( int i = 0; i < (cnt + ID_GROUP_LEN-1); i++ )
+    {
+        this->ids[i] = -1;
+    }
+    for( int i = 0; i < cnt; i++ )
     {
+        if ( old_ids[i] != -1 ) this->slot_insert( id_map[old_ids[i]], old_vals[i] );
+    }
+    delete[] old_ids;
+    delete[] old_vals;
+}
+
+nVal * Hash::val_set( int id )
+{
+    //---------------------------------------
+    // Overwriting an existing id doesn't change the count.
+    // Otherwise append if there's inline room, or grow the table 
+    // once we would pass 3/4 full.
+    //---------------------------------------
+    int i = this->slot_find( id );
+    if ( i >= 0 ) return &this->vals[i];
+
+    nVal v;
+    v.undef();
+    if ( this->mask < 0 ) {
+        if ( this->count < INLINE_CNT ) {
+            i = this->count++;
+            if ( this->mask == MASK_SHAPED ) {
+                this->shape = shape_add( this->shape, id );
+                this->ids = this->shape->ids;
+            } else {
+                this->ids[i] = id;
+            }
+            this->vals[i] = v;
+            return &this->vals[i];
+        }
+        this->table_rebuild( INLINE_CNT << 1 );
+    } else if ( (this->count+1)*4 > (this->mask+1)*3 ) {
+        this->table_rebuild( (this->mask+1) << 1 );
+    }
+    this->count++;
+    return this->slot_insert( id, v );
+}
+
+void Hash::slot_remove( int id )
+{
+    int i = this->slot_find( id );
+    dassert( i >= 0 );
+    this->count--;
+    if ( this->mask == MASK_SHAPED ) {
         //---------------------------------------
-        // See if we need to resize the hash.
+        // Same keys in the same order always lead to the same shape.
         //---------------------------------------
-        if ( this->count == (this->mask >> 1) ) {
-            this->count = 0;
-            int old_mask = this->mask;
-            this->mask = (old_mask << 1) | 1;  // double size
-            dprintf( "resize from %d to %d\n", old_mask+1, this->mask+1 );
-            Entry * old_entries = this->entries;
-            this->entries = new Entry[this->mask+1];
-            Entry * e = this->entries;
-            for( int i = 0; i <= this->mask; i++, e++ )
-            {
-                e->id = -1;
-            } 
-            Entry * oe = old_entries;
-            for( int i = 0; i <= old_mask; i++, oe++ )
-            {
-                if ( oe->id != -1 ) {
-                    e = this->set( oe->id, recursion+1 );
-                    e->kind = oe->kind;
-                    e->u = oe->u;
-                }
-            }
-            delete old_entries;
+        nShape * shape = &shape_root;
+        for( int j = 0; j <= this->count; j++ )
+        {
+            if ( j != i ) shape = shape_add( shape, this->ids[j] );
         }
+        this->shape = shape;
+        this->ids = shape->ids;
+        for( ; i < this->count; i++ )
+        {
+            this->vals[i] = this->vals[i+1];
+        }
+        return;
+    }
 
+    if ( this->mask == MASK_INLINE ) {
         //---------------------------------------
-        // Hash to proper starting entry, then increment from there until
-        // we find existing entry or free entry.
+        // Keep inline entries dense and in order.
         //---------------------------------------
-        this->count++;
-        dassert( id >= 0 );
-        int i = id & this->mask;
-        Entry * e = &this->entries[i];
-        for( int j = 0; j <= this->mask; j++ )
+        for( ; i < this->count; i++ )
         {
-            if( e->id == id || e->id == -1 ) {
-                dprintf( "set() found entry i=%d id=%d e->id=%d recursion=%d\n", i, id, e->id, recursion );
-                e->id = id;
-                return e;
-            } 
-
-            if( i == this->mask ) {
-                i = 0;
-                e = &this->entries[0];
-            } else {
-                i++;
-                e++;
-            }
+            this->ids[i] = this->ids[i+1];
+            this->vals[i] = this->vals[i+1];
         }
-        dassert( 0 && "Should have found a free entry" );
-        return 0;
+        this->ids[i] = -1;
+        return;
     }
-};
+
+    for( ;; )
+    {
+        int j = (i+1) & this->mask;
+        int next_id = this->ids[j];
+        if ( next_id == -1 || this->slot_dist( next_id, j ) == 0 ) break;
+        this->slot_id_set( i, next_id );
+        this->vals[i] = this->vals[j];
+        i = j;
+    }
+    this->slot_id_set( i, -1 );
+}
 
 //---------------------------------------
 // Hash Constructor
 //---------------------------------------
-const int INIT_ENTRY_CNT = 4;
-
-Hash::Hash( void )
+Hash::Hash( bool shaped, nArena * arena )
 {
-    impl = new Impl;
-    impl->count = 0;
-    impl->mask = INIT_ENTRY_CNT-1;
-    impl->entries = new Entry[ INIT_ENTRY_CNT ];
-    Entry * e = impl->entries;
-    for( int id = 0; id < INIT_ENTRY_CNT; id++, e++ )
-    {
-        e->id = -1;   // indicates unused
+    this->count = 0;
+    this->arena = arena;
+    this->vals = this->inline_vals;
+    if ( shaped ) {
+        this->mask = MASK_SHAPED;
+        this->shape = &shape_root;
+        this->ids = shape_root.ids;
+    } else {
+        this->mask = MASK_INLINE;
+        this->ids = this->inline_ids;
+        for( int i = 0; i < INLINE_CNT; i++ )
+        {
+            this->inline_ids[i] = -1;
+        }
     }
 }
 
@@ -208,9 +762,31 @@ Hash::~Hash( void )
     //---------------------------------------
     // No reference counts, just delete the apparatus.
     //---------------------------------------
-    delete impl->entries;
-    impl->entries = nullptr;
-    impl = nullptr;
+    if ( this->mask >= 0 && this->arena == nullptr ) {
+        delete[] this->ids;
+        delete[] this->vals;
+    }
+    this->ids = nullptr;
+    this->vals = nullptr;
+}
+
+//---------------------------------------
+// Hash Capacity
+//---------------------------------------
+Hash& Hash::reserve( int cnt )
+{
+    if ( cnt <= INLINE_CNT && this->mask < 0 ) return *this;
+    int new_cnt = table_cnt( cnt );
+    if ( new_cnt > (this->mask+1) ) this->table_rebuild( new_cnt );
+    return *this;
+}
+
+Hash& Hash::shrink_to_fit( void )
+{
+    if ( this->mask < 0 ) return *this;
+    int new_cnt = (this->count <= INLINE_CNT) ? 0 : table_cnt( this->count );
+    if ( new_cnt < (this->mask+1) ) this->table_rebuild( new_cnt );
+    return *this;
 }
 
 //---------------------------------------
@@ -218,7 +794,7 @@ Hash::~Hash( void )
 //---------------------------------------
 bool Hash::exists( int id )
 {
-    return impl->get( id ) != nullptr;
+    return this->val_get( id ) != nullptr;
 }
 
 //---------------------------------------
@@ -226,8 +802,8 @@ bool Hash::exists( int id )
 //---------------------------------------
 bool Hash::defined( int id )
 {
-    Entry * e = impl->get( id );
-    return e != nullptr && e->kind != UNDEF;
+    nVal * e = this->val_get( id );
+    return e != nullptr && e->kind() != UNDEF;
 }
 
 //---------------------------------------
@@ -235,8 +811,8 @@ bool Hash::defined( int id )
 //---------------------------------------
 nKind Hash::kind( int id )
 {
-    Entry * e = impl->get( id );
-    return (e == nullptr) ? UNDEF : e->kind; 
+    nVal * e = this->val_get( id );
+    return (e == nullptr) ? UNDEF : e->kind(); 
 }
 
 //---------------------------------------
@@ -244,10 +820,7 @@ nKind Hash::kind( int id )
 //---------------------------------------
 Hash& Hash::remove( int id )
 {
-    Entry * e = impl->get( id );
-    dassert( e != nullptr );
-    e->id = -1;
-    impl->count--;
+    this->slot_remove( id );
     return *this;
 }
 
@@ -256,48 +829,50 @@ Hash& Hash::remove( int id )
 //---------------------------------------
 Hash& Hash::undef( int id )
 {
-    Entry * e = impl->set( id );
-    e->kind = UNDEF;
+    nVal * e = this->val_set( id );
+    e->undef();
     return *this;
 }
 
 Hash& Hash::i( int id, nInt v )
 {
-    Entry * e = impl->set( id );
-    e->kind = INT;
-    e->u.i = v;
+    nVal * e = this->val_set( id );
+    e->i( v );
     return *this;
 }
 
 Hash& Hash::f( int id, nFlt v )
 {
-    Entry * e = impl->set( id );
-    e->kind = FLT;
-    e->u.f = v;
+    nVal * e = this->val_set( id );
+    e->f( v );
     return *this;
 }
 
 Hash& Hash::s( int id, nStr v )
 {
-    Entry * e = impl->set( id );
-    e->kind = STR;
-    e->u.s = strdup( v );
+    nVal * e = this->val_set( id );
+    e->s( (this->arena != nullptr) ? this->arena->strdup( v ) : strdup( v ) );
+    return *this;
+}
+
+Hash& Hash::sp( int id, nStr v )
+{
+    nVal * e = this->val_set( id );
+    e->s( v );
     return *this;
 }
 
 Hash& Hash::hp( int id, Hash * v )
 {
-    Entry * e = impl->set( id );
-    e->kind = HASH;
-    e->u.hp = v;
+    nVal * e = this->val_set( id );
+    e->hp( v );
     return *this;
 }
 
 Hash& Hash::lp( int id, List * v )
 {
-    Entry * e = impl->set( id );
-    e->kind = LIST;
-    e->u.lp = v;
+    nVal * e = this->val_set( id );
+    e->lp( v );
     return *this;
 }
 
@@ -306,50 +881,98 @@ Hash& Hash::lp( int id, List * v )
 //---------------------------------------
 nInt Hash::i( int id )
 {
-    Entry * e = impl->get( id, INT );
-    return e->u.i;
+    nVal * e = this->val_get( id, INT );
+    return e->i();
 }
 
 nFlt Hash::f( int id )
 {
-    Entry * e = impl->get( id );
+    nVal * e = this->val_get( id );
     dassert( e != nullptr );
-    if ( e->kind == FLT ) {
-        return e->u.f;
+    if ( e->kind() == FLT ) {
+        return e->f();
     } else {
-        dassert( e->kind == INT );       // implicit conversion
-        return e->u.i;
+        dassert( e->kind() == INT );       // implicit conversion
+        return e->i();
     }
 }
 
 nStr Hash::s( int id )
 {
-    Entry * e = impl->get( id, STR );
-    return e->u.s;
+    nVal * e = this->val_get( id, STR );
+    return e->s();
 }
 
 Hash& Hash::h( int id )
 {
-    Entry * e = impl->get( id, HASH );
-    return *e->u.hp;
+    nVal * e = this->val_get( id, HASH );
+    return *e->hp();
 }
 
 Hash * Hash::hp( int id )
 {
-    Entry * e = impl->get( id, HASH );
-    return e->u.hp;
+    nVal * e = this->val_get( id, HASH );
+    return e->hp();
 }
 
 List& Hash::l( int id )
 {
-    Entry * e = impl->get( id, LIST );
-    return *e->u.lp;
+    nVal * e = this->val_get( id, LIST );
+    return *e->lp();
 }
 
 List * Hash::lp( int id )
 {
-    Entry * e = impl->get( id, LIST );
-    return e->u.lp;
+    nVal * e = this->val_get( id, LIST );
+    return e->lp();
+}
+
+nInt Hash::i( nProp& p )
+{
+    nVal * e = this->val_get( p, INT );
+    return e->i();
+}
+
+nFlt Hash::f( nProp& p )
+{
+    nVal * e = this->val_get( p, UNDEF );
+    dassert( e != nullptr );
+    if ( e->kind() == FLT ) {
+        return e->f();
+    } else {
+        dassert( e->kind() == INT );       // implicit conversion
+        return e->i();
+    }
+}
+
+nStr Hash::s( nProp& p )
+{
+    nVal * e = this->val_get( p, STR );
+    return e->s();
+}
+
+Hash& Hash::h( nProp& p )
+{
+    nVal * e = this->val_get( p, HASH );
+    return *e->hp();
+}
+
+Hash * Hash::hp( nProp& p )
+{
+    nVal * e = this->val_get( p, HASH );
+    return e->hp();
+}
+
+List& Hash::l( nProp& p )
+{
+    nVal * e = this->val_get( p, LIST );
+    return *e->lp();
+}
+
+List * Hash::lp( nProp& p )
+{
+    nVal * e = this->val_get( p, LIST );
+    return e->lp();
 }
 
 //---------------------------------------
@@ -363,12 +986,12 @@ int Hash::id_first( int& hdl )
 
 int Hash::id_next( int& hdl )
 {
-    Entry * e = &impl->entries[hdl];
-    for( int i = hdl; i <= impl->mask; i++, e++ )
+    int cnt = (this->mask < 0) ? this->count : (this->mask+1);
+    for( int i = hdl; i < cnt; i++ )
     {
-        if ( e->id != -1 ) {
+        if ( this->ids[i] != -1 ) {
             hdl = i+1;
-            return e->id;
+            return this->ids[i];
         }
     }
 
@@ -381,8 +1004,8 @@ Hash& Hash::print( const char * s )
     printf( "%s\n", s );
     for( int id = this->id_first( hdl ); id >= 0; id = this->id_next( hdl ) ) 
     {
-        if ( id_str_map.count( id ) ) {
-            printf( "    %s => ", id_str_map[id] );
+        if ( id < str_ids.id_next.load( std::memory_order_relaxed ) ) {
+            printf( "    %s => ", Hash::id_to_str( id ) );
         } else {
             printf( "    %d => ", id );
         }
@@ -422,3 +1045,239 @@ Hash& Hash::print( const char * s )
 
     return *this;
 }
+
+//---------------------------------------
+// Structural Equality
+//
+// Nested hashes and lists compare by address, so equal() and digest() 
+// are shallow.  That is enough for NodeIO's dedupe, which works bottom up
+// and so has already made identical children the same object.
+//---------------------------------------
+static inline uint64_t digest_mix( uint64_t x )
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+bool nVal::same( const nVal& other ) const
+{
+    if ( this->kind() != other.kind() ) return false;
+
+    switch( this->kind() )
+    {
+        case UNDEF:     return true;
+        case INT:       return this->i() == other.i();
+        case FLT:       { nFlt a = this->f(), b = other.f(); return memcmp( &a, &b, sizeof( nFlt ) ) == 0; }
+        case STR:       return this->s() == other.s() || 
+                               (this->s() != nullptr && other.s() != nullptr && strcmp( this->s(), other.s() ) == 0);
+        case HASH:      return this->hp() == other.hp();
+        case LIST:      return this->lp() == other.lp();
+        default:        dassert( 0 ); return false;
+    }
+}
+
+uint64_t nVal::digest( void ) const
+{
+    uint64_t x;
+    switch( this->kind() )
+    {
+        case UNDEF:     x = 0;                                  break;
+        case INT:       x = uint64_t( this->i() );              break;
+        case FLT:       { nFlt f = this->f(); memcpy( &x, &f, sizeof( x ) ); break; }
+        case STR:       { int len; x = (this->s() == nullptr) ? 0 : str_hash( this->s(), len ); break; }
+        case HASH:      x = uint64_t( uintptr_t( this->hp() ) ); break;
+        case LIST:      x = uint64_t( uintptr_t( this->lp() ) ); break;
+        default:        dassert( 0 ); x = 0;                    break;
+    }
+    return digest_mix( x ^ (uint64_t( this->kind() ) << 56) );
+}
+
+bool Hash::equal( Hash& other )
+{
+    if ( this->count != other.count ) return false;
+
+    int n = (this->mask < 0) ? this->count : (this->mask+1);
+    for( int i = 0; i < n; i++ )
+    {
+        if ( this->mask >= 0 && this->ids[i] == -1 ) continue;
+        nVal * v = other.val_get( this->ids[i] );
+        if ( v == nullptr || !this->vals[i].same( *v ) ) return false;
+    }
+    return true;
+}
+
+uint64_t Hash::digest( void )
+{
+    uint64_t h = this->count;
+    int n = (this->mask < 0) ? this->count : (this->mask+1);
+    for( int i = 0; i < n; i++ )
+    {
+        if ( this->mask >= 0 && this->ids[i] == -1 ) continue;
+        h += digest_mix( uint64_t( this->ids[i] ) * 0x9e3779b97f4a7c15ull ^ this->vals[i].digest() );
+    }
+    return digest_mix( h );
+}
+
+//---------------------------------------
+// Hash Stats
+//---------------------------------------
+Hash& Hash::stats( nStats& st, bool tree )
+{
+    if ( !st.node_first( this ) ) return *this;
+    st.hash_cnt++;
+    st.hash_prop_cnt += this->count;
+    st.hash_bytes += sizeof( Hash );
+    if ( this->mask < 0 ) {
+        if ( this->mask == MASK_SHAPED ) {
+            st.hash_shaped_cnt++;
+        } else {
+            st.hash_inline_cnt++;
+        }
+        st.hash_slot_cnt += INLINE_CNT;
+        st.hash_probe_hist[0] += this->count;   // one group compare
+    } else {
+        int cnt = this->mask+1;
+        st.hash_slot_cnt += cnt;
+        st.hash_bytes += (cnt + ID_GROUP_LEN-1) * sizeof( int ) + cnt * sizeof( nVal );
+        for( int i = 0; i < cnt; i++ )
+        {
+            if ( this->ids[i] == -1 ) continue;
+            int d = this->slot_dist( this->ids[i], i );
+            st.hash_probe_hist[(d < nStats::PROBE_HIST_LEN) ? d : (nStats::PROBE_HIST_LEN-1)]++;
+        }
+    }
+
+    int n = (this->mask < 0) ? this->count : (this->mask+1);
+    for( int i = 0; i < n; i++ )
+    {
+        if ( this->mask >= 0 && this->ids[i] == -1 ) continue;
+        st.val_add( this->vals[i], tree );
+    }
+    return *this;
+}
+
+long Hash::resize_cnt( void )
+{
+    return hash_resize_total.load( std::memory_order_relaxed );
+}
+
+//---------------------------------------
+// Stats Accumulator
+//---------------------------------------
+nStats::nStats( void )
+{
+    this->seen = nullptr;
+    this->seen_mask = -1;
+    this->seen_cnt = 0;
+    this->hash_cnt = 0;
+    this->hash_inline_cnt = 0;
+    this->hash_shaped_cnt = 0;
+    this->hash_prop_cnt = 0;
+    this->hash_slot_cnt = 0;
+    for( int d = 0; d < PROBE_HIST_LEN; d++ ) this->hash_probe_hist[d] = 0;
+    this->hash_bytes = 0;
+    this->list_cnt = 0;
+    this->list_packed_cnt = 0;
+    this->list_entry_cnt = 0;
+    this->list_alloc_cnt = 0;
+    this->list_bytes = 0;
+    this->str_bytes = 0;
+    this->parse_node_cnt = 0;
+    this->parse_shared_cnt = 0;
+}
+
+nStats::~nStats()
+{
+    delete[] this->seen;
+}
+
+bool nStats::node_first( const void * node )
+{
+    //---------------------------------------
+    // Open-addressed set of node pointers, kept at most half full.
+    //---------------------------------------
+    if ( (this->seen_cnt+1) > ((this->seen_mask+1) >> 1) ) {
+        long          old_cnt = this->seen_mask+1;
+        const void ** old     = this->seen;
+        long          cnt     = (old_cnt < 64) ? 64 : (old_cnt << 1);
+        this->seen = new const void *[cnt];
+        this->seen_mask = cnt-1;
+        for( long i = 0; i < cnt; i++ ) this->seen[i] = nullptr;
+        for( long i = 0; i < old_cnt; i++ )
+        {
+            if ( old[i] == nullptr ) continue;
+            long j = digest_mix( reinterpret_cast<uintptr_t>( old[i] ) ) & this->seen_mask;
+            while( this->seen[j] != nullptr ) j = (j+1) & this->seen_mask;
+            this->seen[j] = old[i];
+        }
+        delete[] old;
+    }
+    long i = digest_mix( reinterpret_cast<uintptr_t>( node ) ) & this->seen_mask;
+    for( ; this->seen[i] != nullptr; i = (i+1) & this->seen_mask )
+    {
+        if ( this->seen[i] == node ) return false;
+    }
+    this->seen[i] = node;
+    this->seen_cnt++;
+    return true;
+}
+
+void nStats::val_add( const nVal& v, bool tree )
+{
+    switch( v.kind() )
+    {
+        case STR:
+            if ( v.s() != nullptr ) this->str_bytes += strlen( v.s() ) + 1;
+            break;
+
+        case HASH:
+            if ( tree && v.hp() != nullptr ) v.hp()->stats( *this, tree );
+            break;
+
+        case LIST:
+            if ( tree && v.lp() != nullptr ) v.lp()->stats( *this, tree );
+            break;
+
+        default:
+            break;
+    }
+}
+
+double nStats::hash_load( void ) const
+{
+    return (this->hash_slot_cnt == 0) ? 0.0 : (double( this->hash_prop_cnt ) / double( this->hash_slot_cnt ));
+}
+
+double nStats::hash_probe_avg( void ) const
+{
+    long sum = 0;
+    for( int d = 0; d < PROBE_HIST_LEN; d++ ) sum += d * this->hash_probe_hist[d];
+    return (this->hash_prop_cnt == 0) ? 0.0 : (double( sum ) / double( this->hash_prop_cnt ));
+}
+
+const nStats& nStats::print( nStr s ) const
+{
+    printf( "%s\n", s );
+    printf( "    hashes:       %ld (%ld inline, %ld shaped, %ld tables)\n", 
+            this->hash_cnt, this->hash_inline_cnt, this->hash_shaped_cnt, 
+            this->hash_cnt - this->hash_inline_cnt - this->hash_shaped_cnt );
+    printf( "    properties:   %ld in %ld slots, load %.3f\n", this->hash_prop_cnt, this->hash_slot_cnt, this->hash_load() );
+    printf( "    probe length: avg %.3f, histogram", this->hash_probe_avg() );
+    for( int d = 0; d < PROBE_HIST_LEN; d++ ) printf( " %ld", this->hash_probe_hist[d] );
+    printf( "\n" );
+    printf( "    hash bytes:   %ld\n", this->hash_bytes );
+    printf( "    lists:        %ld (%ld packed) with %ld entries in %ld allocated\n", 
+            this->list_cnt, this->list_packed_cnt, this->list_entry_cnt, this->list_alloc_cnt );
+    printf( "    list bytes:   %ld\n", this->list_bytes );
+    printf( "    string bytes: %ld\n", this->str_bytes );
+    if ( this->parse_node_cnt != 0 ) {
+        printf( "    deduped:      %ld of %ld parsed hashes and lists (%.1f%%)\n", 
+                this->parse_shared_cnt, this->parse_node_cnt, 
+                100.0 * double( this->parse_shared_cnt ) / double( this->parse_node_cnt ) );
+    }
+    return *this;
+}
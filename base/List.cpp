@@ -20,96 +20,290 @@
 // 
 #include "List.h"
 #include "Misc.h"
+#include <atomic>
 
 //---------------------------------------
-// List Entry
+// List Implementation
+//
+// Entries start out in the List object itself and move to a heap array
+// (doubling each time) once they outgrow it.
+//
+// The entries need not start at the beginning of the allocation: there 
+// may be "head" free slots in front of them.  shift*() just steps over
+// the first entry and unshift*() steps back into that space, so using a
+// List as a queue or deque is O(1) per operation.  When one end runs out
+// of room, the entries are either slid over (if the allocation is at most 
+// half full) or moved to a bigger allocation, which keeps everything 
+// amortized O(1) and the entries contiguous.
+//
+// While every entry is an INT, or every entry is a FLT, the entries are 
+// stored packed as a plain nInt[] or nFlt[] with no kinds ("packed" says 
+// which).  The first entry of any other kind unpacks the list into nVals
+// for good, unless the list empties out first.  count, alloc_count and head 
+// are always in units of whichever representation is current.
 //---------------------------------------
-class Entry 
+inline char * List::block_alloc( int len )
 {
-public:
-    nKind kind;
-    union
-    {
-        nInt    i;
-        nFlt    f;
-        nStr    s;
-        Hash *  hp;
-        List *  lp;
-    } u;
-};
-
-class List::Impl
-{
-public:
-    int     count;              // entries used
-    int     alloc_count;        // allocated entries
-    Entry * entries;            // array of allocated entries
-
-    inline Entry * get( int i, nKind kind = UNDEF )
-    {
-        dassert( i >= 0 );
-        dassert( i < this->count );
-        Entry * e = &this->entries[i];
-        dassert( kind == UNDEF || e->kind == kind );
-        return e;
+    return (this->arena != nullptr) ? static_cast<char *>( this->arena->alloc( len ) ) : static_cast<char *>( malloc( len ) );
+}
+
+inline void List::block_free( char * base )
+{
+    if ( this->arena == nullptr ) free( base );
+}
+
+inline int List::entry_len( void )
+{
+    return (this->packed == UNDEF) ? sizeof( nVal ) : sizeof( nInt );
+}
+
+inline char * List::entries_base( void )
+{
+    return this->bytes - this->head*this->entry_len();
+}
+
+inline bool List::entries_inline( void )
+{
+    return this->entries_base() == reinterpret_cast<char *>( this->inline_entries );
+}
+
+inline nVal * List::entry_get( int i, nKind kind )
+{
+    dassert( this->packed == UNDEF );
+    dassert( i >= 0 );
+    dassert( i < this->count );
+    nVal * e = &this->entries[i];
+    dassert( kind == UNDEF || e->kind() == kind );
+    return e;
+}
+
+inline nVal List::entry_val( int i )
+{
+    //---------------------------------------
+    // Entry i as an nVal whether packed or not.
+    //---------------------------------------
+    if ( this->packed == UNDEF ) return *this->entry_get( i );
+    nVal v;
+    if ( this->packed == INT ) {
+        v.i( this->ints[i] );
+    } else {
+        v.f( this->flts[i] );
     }
+    return v;
+}
 
-    Entry * set( int i )
+nVal * List::entry_set( int i )
+{
+    dassert( i >= 0 );
+    if ( this->packed != UNDEF ) this->unpack();
+    this->room_make( i );
+
+    for( ; this->count <= i; this->count++ )
     {
-        dassert( i >= 0 );
-        if ( i >= this->alloc_count ) {
-            //---------------------------------------
-            // Resize Array
-            //---------------------------------------
+        this->entries[this->count].undef();  // fill any gap
+    }
+
+    return &this->entries[i];
+}
+
+inline bool List::packed_set( int i, nKind kind )
+{
+    //---------------------------------------
+    // Makes room for packed entry i if the list is (or can become) 
+    // packed with this kind.  Otherwise unpacks it.
+    //---------------------------------------
+    if ( this->count == 0 && i == 0 && this->packed != kind ) this->repack( kind );
+    if ( this->packed == kind && i <= this->count ) {
+        this->room_make( i );
+        if ( i == this->count ) this->count++;
+        return true;
+    }
+    if ( this->packed != UNDEF ) this->unpack();
+    return false;
+}
+
+void List::room_make( int i )
+{
+    if ( i >= (this->alloc_count - this->head) ) {
+        //---------------------------------------
+        // Out of room at the end.  
+        //---------------------------------------
+        if ( this->head != 0 && (i+1) <= (this->alloc_count >> 1) ) {
+            this->entries_move( 0 );
+        } else {
             int new_alloc_count = alloc_count << 1;
             while( new_alloc_count <= i ) 
             {
                 new_alloc_count <<= 1;
             }
-
-            Entry * new_entries = new Entry[ new_alloc_count ];
-            memcpy( new_entries, this->entries, this->count * sizeof( Entry ) );
-            memset( &new_entries[this->count], 0, (new_alloc_count-this->count) * sizeof( Entry ) );
-            this->alloc_count = new_alloc_count;
-            delete this->entries;
-            this->entries = new_entries;
+            this->entries_realloc( new_alloc_count, 0 );
         }
+    }
+}
 
-        if ( i >= this->count ) {
-            this->count = i+1;
-        }
+static std::atomic<long> list_resize_total( 0 );
 
-        return &this->entries[i];
+void List::entries_realloc( int cnt, int head )
+{
+    //---------------------------------------
+    // Moves the entries to an allocation of exactly cnt, 
+    // starting at head, or back into the object if they fit.
+    //---------------------------------------
+    dassert( (head + this->count) <= cnt );
+    int len = this->entry_len();
+    int inline_cnt = sizeof( this->inline_entries ) / len;
+    char * old_base = this->entries_base();
+    bool   was_inline = this->entries_inline();
+    if ( cnt <= inline_cnt ) {
+        if ( was_inline ) {
+            this->entries_move( head );
+            return;
+        }
+        cnt = inline_cnt;
     }
+    list_resize_total.fetch_add( 1, std::memory_order_relaxed );
+    char * new_base = (cnt == inline_cnt) ? reinterpret_cast<char *>( this->inline_entries ) : this->block_alloc( cnt * len );
+    memcpy( &new_base[head*len], this->bytes, this->count * len );
+    this->alloc_count = cnt;
+    this->head = head;
+    this->bytes = &new_base[head*len];
+    if ( !was_inline ) this->block_free( old_base );
+}
 
-    void shift_up( void )
-    {
-        this->set( this->count );  // causes resize if needed
-        memcpy( &this->entries[1], &this->entries[0], (this->count-1) * sizeof( Entry ) );
-        // we'll assume that index 0 is set after this call, so no need to do anything here
+void List::entries_move( int head )
+{
+    //---------------------------------------
+    // Slides the entries within the current allocation.
+    //---------------------------------------
+    dassert( (head + this->count) <= this->alloc_count );
+    int len = this->entry_len();
+    char * new_bytes = &this->entries_base()[head*len];
+    memmove( new_bytes, this->bytes, this->count * len );
+    this->head = head;
+    this->bytes = new_bytes;
+}
+
+void List::repack( nKind kind )
+{
+    //---------------------------------------
+    // Empty list: just reinterpret the allocation.
+    //---------------------------------------
+    dassert( this->count == 0 );
+    int alloc_len = this->alloc_count * this->entry_len();
+    this->bytes = this->entries_base();
+    this->head = 0;
+    this->packed = kind;
+    this->alloc_count = alloc_len / this->entry_len();
+}
+
+void List::unpack( void )
+{
+    //---------------------------------------
+    // Packed -> nVals, keeping the same number of entries of room.
+    //---------------------------------------
+    dassert( this->packed != UNDEF );
+    nKind kind = this->packed;
+    int   cnt = this->alloc_count - this->head;
+    char * old_base = this->entries_base();
+    bool   was_inline = this->entries_inline();
+    nInt   saved[INLINE_CNT * sizeof( nVal ) / sizeof( nInt )];
+    char * src = this->bytes;
+    if ( was_inline ) {
+        memcpy( saved, src, this->count * sizeof( nInt ) );
+        src = reinterpret_cast<char *>( saved );
     }
 
-    void shift_down( void )
+    list_resize_total.fetch_add( 1, std::memory_order_relaxed );
+    if ( cnt <= INLINE_CNT ) cnt = INLINE_CNT;
+    nVal * vals = (cnt == INLINE_CNT) ? this->inline_entries : reinterpret_cast<nVal *>( this->block_alloc( cnt * sizeof( nVal ) ) );
+    for( int i = 0; i < this->count; i++ )
     {
-        this->count--;
-        memcpy( &this->entries[0], &this->entries[1], this->count * sizeof( Entry ) );
+        if ( kind == INT ) {
+            vals[i].i( reinterpret_cast<nInt *>( src )[i] );
+        } else {
+            vals[i].f( reinterpret_cast<nFlt *>( src )[i] );
+        }
+    }
+    this->packed = UNDEF;
+    this->alloc_count = cnt;
+    this->head = 0;
+    this->entries = vals;
+    if ( !was_inline ) this->block_free( old_base );
+}
+
+void List::shift_up( void )
+{
+    if ( this->head == 0 ) {
+        //---------------------------------------
+        // Out of room at the front.  Leave as much room 
+        // in front as there are entries.
+        //---------------------------------------
+        int new_head = (this->count > 0) ? this->count : 1;
+        if ( (this->count+1)*2 <= this->alloc_count ) {
+            this->entries_move( (this->alloc_count - this->count) >> 1 );
+        } else {
+            this->entries_realloc( new_head + (this->alloc_count << 1), new_head );
+        }
     }
-};
+    this->head--;
+    this->bytes -= this->entry_len();
+    this->count++;
+    // we'll assume that index 0 is set after this call, so no need to do anything here
+}
 
-const int INIT_ENTRY_CNT = 4;
+void List::shift_down( void )
+{
+    this->count--;
+    if ( this->count == 0 ) {
+        this->bytes = this->entries_base();
+        this->head = 0;
+    } else {
+        this->bytes += this->entry_len();
+        this->head++;
+    }
+}
 
 //---------------------------------------
 // List Constructor
 //---------------------------------------
-List::List( void )
+List::List( nArena * arena )
 {
-    impl = new Impl;
-    impl->count = 0;
-    impl->alloc_count = INIT_ENTRY_CNT;
-    impl->entries = new Entry[ INIT_ENTRY_CNT ];
-    for( int i = 0; i < INIT_ENTRY_CNT; i++ )
+    this->arena = arena;
+    this->count = 0;
+    this->head = 0;
+    this->packed = UNDEF;
+    this->alloc_count = INLINE_CNT;
+    this->entries = this->inline_entries;
+}
+
+List::List( const nVal * vals, int cnt, nArena * arena )
+{
+    dassert( cnt >= 0 );
+    this->arena = arena;
+    nKind kind = (cnt > 0) ? vals[0].kind() : UNDEF;
+    for( int i = 1; i < cnt && (kind == INT || kind == FLT); i++ )
     {
-        impl->entries[i].kind = UNDEF;
+        if ( vals[i].kind() != kind ) kind = UNDEF;
+    }
+    this->packed = (kind == INT || kind == FLT) ? kind : UNDEF;
+    this->count = cnt;
+    this->head = 0;
+
+    int len = this->entry_len();
+    int inline_cnt = sizeof( this->inline_entries ) / len;
+    this->alloc_count = (cnt <= inline_cnt) ? inline_cnt : cnt;
+    this->bytes = (cnt <= inline_cnt) ? reinterpret_cast<char *>( this->inline_entries ) : this->block_alloc( cnt * len );
+    if ( this->packed == UNDEF ) {
+        memcpy( this->entries, vals, cnt * sizeof( nVal ) );
+    } else {
+        for( int i = 0; i < cnt; i++ )
+        {
+            if ( kind == INT ) {
+                this->ints[i] = vals[i].i();
+            } else {
+                this->flts[i] = vals[i].f();
+            }
+        }
     }
 }
 
@@ -121,9 +315,41 @@ List::~List( void )
     //---------------------------------------
     // No reference counts, just delete the apparatus.
     //---------------------------------------
-    delete impl->entries;
-    impl->entries = nullptr;
-    impl = nullptr;
+    if ( !this->entries_inline() ) this->block_free( this->entries_base() );
+    this->entries = nullptr;
+}
+
+//---------------------------------------
+// List Capacity
+//---------------------------------------
+List& List::reserve( int cnt )
+{
+    if ( cnt > (this->alloc_count - this->head) ) this->entries_realloc( cnt, 0 );
+    return *this;
+}
+
+List& List::shrink_to_fit( void )
+{
+    if ( !this->entries_inline() && this->count < this->alloc_count ) this->entries_realloc( this->count, 0 );
+    return *this;
+}
+
+//---------------------------------------
+// List Packed Entries
+//---------------------------------------
+nKind List::packed_kind( void )
+{
+    return this->packed;
+}
+
+nInt * List::ip( void )
+{
+    return (this->packed == INT) ? this->ints : nullptr;
+}
+
+nFlt * List::fp( void )
+{
+    return (this->packed == FLT) ? this->flts : nullptr;
 }
 
 //---------------------------------------
@@ -131,7 +357,7 @@ List::~List( void )
 //---------------------------------------
 int List::length( void )
 {
-    return impl->count;
+    return this->count;
 }
 
 //---------------------------------------
@@ -140,7 +366,7 @@ int List::length( void )
 bool List::exists( int i )
 {
     dassert( i >= 0 );
-    return i < impl->count;
+    return i < this->count;
 }
 
 //---------------------------------------
@@ -148,8 +374,9 @@ bool List::exists( int i )
 //---------------------------------------
 bool List::defined( int i )
 {
-    Entry * e = impl->get( i );
-    return e != nullptr && e->kind != UNDEF;
+    if ( this->packed != UNDEF ) return this->exists( i );
+    nVal * e = this->entry_get( i );
+    return e != nullptr && e->kind() != UNDEF;
 }
 
 //---------------------------------------
@@ -157,8 +384,9 @@ bool List::defined( int i )
 //---------------------------------------
 nKind List::kind( int i )
 {
-    Entry * e = impl->get( i );
-    return (e == nullptr) ? UNDEF : e->kind; 
+    if ( this->packed != UNDEF ) return this->exists( i ) ? this->packed : UNDEF;
+    nVal * e = this->entry_get( i );
+    return (e == nullptr) ? UNDEF : e->kind(); 
 }
 
 //---------------------------------------
@@ -166,48 +394,51 @@ nKind List::kind( int i )
 //---------------------------------------
 List& List::undef( int i )
 {
-    Entry * e = impl->set( i );
-    e->kind = UNDEF;
+    nVal * e = this->entry_set( i );
+    e->undef();
     return *this;
 }
 
 List& List::i( int i, nInt v )
 {
-    Entry * e = impl->set( i );
-    e->kind = INT;
-    e->u.i = v;
+    if ( this->packed_set( i, INT ) ) {
+        this->ints[i] = v;
+        return *this;
+    }
+    nVal * e = this->entry_set( i );
+    e->i( v );
     return *this;
 }
 
 List& List::f( int i, nFlt v )
 {
-    Entry * e = impl->set( i );
-    e->kind = FLT;
-    e->u.f = v;
+    if ( this->packed_set( i, FLT ) ) {
+        this->flts[i] = v;
+        return *this;
+    }
+    nVal * e = this->entry_set( i );
+    e->f( v );
     return *this;
 }
 
 List& List::s( int i, nStr v )
 {
-    Entry * e = impl->set( i );
-    e->kind = STR;
-    e->u.s = v;
+    nVal * e = this->entry_set( i );
+    e->s( v );
     return *this;
 }
 
 List& List::hp( int i, Hash * v )
 {
-    Entry * e = impl->set( i );
-    e->kind = HASH;
-    e->u.hp = v;
+    nVal * e = this->entry_set( i );
+    e->hp( v );
     return *this;
 }
 
 List& List::lp( int i, List * v )
 {
-    Entry * e = impl->set( i );
-    e->kind = LIST;
-    e->u.lp = v;
+    nVal * e = this->entry_set( i );
+    e->lp( v );
     return *this;
 }
 
@@ -216,44 +447,52 @@ List& List::lp( int i, List * v )
 //---------------------------------------
 nInt List::i( int i )
 {
-    Entry * e = impl->get( i, INT );
-    return e->u.i;
+    if ( this->packed == INT ) {
+        dassert( i >= 0 && i < this->count );
+        return this->ints[i];
+    }
+    nVal * e = this->entry_get( i, INT );
+    return e->i();
 }
 
 nFlt List::f( int i )
 {
-    Entry * e = impl->get( i, FLT );
-    return e->u.f;
+    if ( this->packed == FLT ) {
+        dassert( i >= 0 && i < this->count );
+        return this->flts[i];
+    }
+    nVal * e = this->entry_get( i, FLT );
+    return e->f();
 }
 
 nStr List::s( int i )
 {
-    Entry * e = impl->get( i, STR );
-    return e->u.s;
+    nVal * e = this->entry_get( i, STR );
+    return e->s();
 }
 
 Hash& List::h( int i )
 {
-    Entry * e = impl->get( i, HASH );
-    return *e->u.hp;
+    nVal * e = this->entry_get( i, HASH );
+    return *e->hp();
 }
 
 Hash * List::hp( int i )
 {
-    Entry * e = impl->get( i, HASH );
-    return e->u.hp;
+    nVal * e = this->entry_get( i, HASH );
+    return e->hp();
 }
 
 List& List::l( int i )
 {
-    Entry * e = impl->get( i, LIST );
-    return *e->u.lp;
+    nVal * e = this->entry_get( i, LIST );
+    return *e->lp();
 }
 
 List * List::lp( int i )
 {
-    Entry * e = impl->get( i, LIST );
-    return e->u.lp;
+    nVal * e = this->entry_get( i, LIST );
+    return e->lp();
 }
 
 //---------------------------------------
@@ -261,27 +500,27 @@ List * List::lp( int i )
 //---------------------------------------
 List& List::pushi( nInt v )
 {
-    return this->i( impl->count, v );
+    return this->i( this->count, v );
 }
 
 List& List::pushf( nFlt v )
 {
-    return this->f( impl->count, v );
+    return this->f( this->count, v );
 }
 
 List& List::pushs( nStr v )
 {
-    return this->s( impl->count, v );
+    return this->s( this->count, v );
 }
 
 List& List::pushhp( Hash * v )
 {
-    return this->hp( impl->count, v );
+    return this->hp( this->count, v );
 }
 
 List& List::pushlp( List * v )
 {
-    return this->lp( impl->count, v );
+    return this->lp( this->count, v );
 }
 
 //---------------------------------------
@@ -289,58 +528,58 @@ List& List::pushlp( List * v )
 //---------------------------------------
 nInt List::popi( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == INT );
-    return e->u.i;
+    dassert( this->count > 0 );
+    nInt v = this->i( this->count-1 );
+    this->count--;
+    return v;
 }
 
 nFlt List::popf( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == FLT );
-    return e->u.f;
+    dassert( this->count > 0 );
+    nFlt v = this->f( this->count-1 );
+    this->count--;
+    return v;
 }
 
 nStr List::pops( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == STR );
-    return e->u.s;
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[--this->count];
+    dassert( e->kind() == STR );
+    return e->s();
 }
 
 Hash& List::poph( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == HASH );
-    return *e->u.hp;
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[--this->count];
+    dassert( e->kind() == HASH );
+    return *e->hp();
 }
 
 Hash * List::pophp( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == HASH );
-    return e->u.hp;
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[--this->count];
+    dassert( e->kind() == HASH );
+    return e->hp();
 }
 
 List& List::popl( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == LIST );
-    return *e->u.lp;
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[--this->count];
+    dassert( e->kind() == LIST );
+    return *e->lp();
 }
 
 List * List::poplp( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[--impl->count];
-    dassert( e->kind == LIST );
-    return e->u.lp;
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[--this->count];
+    dassert( e->kind() == LIST );
+    return e->lp();
 }
 
 //---------------------------------------
@@ -348,31 +587,31 @@ List * List::poplp( void )
 //---------------------------------------
 List& List::unshifti( nInt v )
 {
-    impl->shift_up();
+    this->shift_up();
     return this->i( 0, v );
 }
 
 List& List::unshiftf( nFlt v )
 {
-    impl->shift_up();
+    this->shift_up();
     return this->f( 0, v );
 }
 
 List& List::unshifts( nStr v )
 {
-    impl->shift_up();
+    this->shift_up();
     return this->s( 0, v );
 }
 
 List& List::unshifthp( Hash * v )
 {
-    impl->shift_up();
+    this->shift_up();
     return this->hp( 0, v );
 }
 
 List& List::unshiftlp( List * v )
 {
-    impl->shift_up();
+    this->shift_up();
     return this->lp( 0, v );
 }
 
@@ -381,98 +620,102 @@ List& List::unshiftlp( List * v )
 //---------------------------------------
 nInt List::shifti( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == INT );
-    nInt v = e->u.i;
-    impl->shift_down();
+    dassert( this->count > 0 );
+    nInt v = this->i( 0 );
+    this->shift_down();
     return v;
 }
 
 nFlt List::shiftf( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == FLT );
-    nFlt v = e->u.f;
-    impl->shift_down();
+    dassert( this->count > 0 );
+    nFlt v = this->f( 0 );
+    this->shift_down();
     return v;
 }
 
 nStr List::shifts( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == STR );
-    nStr v = e->u.s;
-    impl->shift_down();
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[0];
+    dassert( e->kind() == STR );
+    nStr v = e->s();
+    this->shift_down();
     return v;
 }
 
 Hash& List::shifth( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == HASH );
-    Hash& v = *e->u.hp;
-    impl->shift_down();
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[0];
+    dassert( e->kind() == HASH );
+    Hash& v = *e->hp();
+    this->shift_down();
     return v;
 }
 
 Hash * List::shifthp( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == HASH );
-    Hash * v = e->u.hp;
-    impl->shift_down();
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[0];
+    dassert( e->kind() == HASH );
+    Hash * v = e->hp();
+    this->shift_down();
     return v;
 }
 
 List& List::shiftl( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == LIST );
-    List& v = *e->u.lp;
-    impl->shift_down();
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[0];
+    dassert( e->kind() == LIST );
+    List& v = *e->lp();
+    this->shift_down();
     return v;
 }
 
 List * List::shiftlp( void )
 {
-    dassert( impl->count > 0 );
-    Entry * e = &impl->entries[0];
-    dassert( e->kind == LIST );
-    List * v = e->u.lp;
-    impl->shift_down();
+    dassert( this->count > 0 && this->packed == UNDEF );
+    nVal * e = &this->entries[0];
+    dassert( e->kind() == LIST );
+    List * v = e->lp();
+    this->shift_down();
     return v;
 }
 
 List& List::print( nStr s )
 {
     printf( "%s\n", s );
-    Entry * e = impl->entries;
-    for( int i = 0; i < impl->count; i++, e++ )
+    for( int i = 0; i < this->count; i++ )
     {
         printf( "    %d => ", i );
+        if ( this->packed != UNDEF ) {
+            if ( this->packed == INT ) {
+                printf( "%ld\n", this->ints[i] );
+            } else {
+                printf( "%f\n", this->flts[i] );
+            }
+            continue;
+        }
 
-        switch( e->kind )
+        nVal * e = &this->entries[i];
+        switch( e->kind() )
         {
             case UNDEF: 
                 printf( "undef" ); 
                 break;
 
             case INT:
-                printf( "%ld", e->u.i );
+                printf( "%ld", e->i() );
                 break;
 
             case FLT:
-                printf( "%f", e->u.f );
+                printf( "%f", e->f() );
                 break;
 
             case STR:
-                printf( "%s", e->u.s );
+                printf( "%s", e->s() );
                 break;
 
             case HASH:
@@ -492,3 +735,56 @@ List& List::print( nStr s )
 
     return *this;
 }
+
+//---------------------------------------
+// Structural Equality (see Hash.cpp)
+//---------------------------------------
+bool List::equal( List& other )
+{
+    if ( this->count != other.count ) return false;
+    if ( this->packed != UNDEF && this->packed == other.packed ) {
+        return memcmp( this->bytes, other.bytes, this->count * sizeof( nInt ) ) == 0;
+    }
+    for( int i = 0; i < this->count; i++ )
+    {
+        if ( !this->entry_val( i ).same( other.entry_val( i ) ) ) return false;
+    }
+    return true;
+}
+
+uint64_t List::digest( void )
+{
+    uint64_t h = 0x6c6973740000ull ^ uint64_t( this->count );
+    for( int i = 0; i < this->count; i++ )
+    {
+        h = (h ^ this->entry_val( i ).digest()) * 0x100000001b3ull;
+    }
+    return h ^ (h >> 29);
+}
+
+//---------------------------------------
+// List Stats
+//---------------------------------------
+List& List::stats( nStats& st, bool tree )
+{
+    if ( !st.node_first( this ) ) return *this;
+    st.list_cnt++;
+    st.list_entry_cnt += this->count;
+    st.list_alloc_cnt += this->alloc_count;
+    st.list_bytes += sizeof( List );
+    if ( !this->entries_inline() ) st.list_bytes += this->alloc_count * this->entry_len();
+    if ( this->packed != UNDEF ) {
+        st.list_packed_cnt++;
+        return *this;
+    }
+    for( int i = 0; i < this->count; i++ )
+    {
+        st.val_add( this->entries[i], tree );
+    }
+    return *this;
+}
+
+long List::resize_cnt( void )
+{
+    return list_resize_total.load( std::memory_order_relaxed );
+}
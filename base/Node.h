@@ -26,6 +26,11 @@
 //          such as Python or Javascript. Our goal here is purely performance, not elegance.
 //
 #include <string>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Misc.h"
 
 typedef long         nInt;      // 64-bit integer 
 typedef double       nFlt;      // 64-bit float
@@ -44,7 +49,205 @@ typedef enum
     LIST  = 5 
 } nKind;
 
+typedef enum
+{
+    CODEC_NONE = 0,                     // plain text
+    CODEC_GZIP = 1,
+    CODEC_ZSTD = 2,                     // needs a build with -DNODEIO_ZSTD (see NodeIO.cpp)
+    CODEC_LZ4  = 3                      // needs a build with -DNODEIO_LZ4
+} nCodec;
+
+class Hash;
 class List;
+class nShape;
+class nArena;
+
+//---------------------------------------
+// Property Value (kind + payload)
+//
+// By default this is an nKind plus a 64-bit union, 16 bytes in all.
+//
+// Building with -DNODE_NANBOX packs both into 8 bytes instead.  FLTs are 
+// stored as themselves, with any NaN made the one positive quiet NaN.
+// Every other kind is a negative quiet NaN with the kind in bits 48..50 
+// and the payload in bits 0..47.  That leaves room for user-space pointers,
+// but INTs are limited to 48 bits (-2^47 .. 2^47-1); setting a larger 
+// one is an error.
+//---------------------------------------
+class nVal
+{
+public:
+    nKind   kind( void ) const;
+    nInt    i( void ) const;
+    nFlt    f( void ) const;
+    nStr    s( void ) const;
+    Hash *  hp( void ) const;
+    List *  lp( void ) const;
+
+    void    undef( void );
+    void    i( nInt v );
+    void    f( nFlt v );
+    void    s( nStr v );
+    void    hp( Hash * v );
+    void    lp( List * v );
+
+    bool     same( const nVal& other ) const;    // same kind and value; strings by contents, Hash/List by address
+    uint64_t digest( void ) const;              // hash of what same() compares
+
+private:
+#ifdef NODE_NANBOX
+    static const uint64_t BOX          = 0xfff8000000000000ULL;        // negative quiet NaN
+    static const uint64_t CANONICAL_NAN= 0x7ff8000000000000ULL;
+    static const uint64_t PAYLOAD_MASK = 0x0000ffffffffffffULL;
+    static const int      KIND_SHIFT   = 48;
+
+    uint64_t bits;
+
+    void    box( nKind kind, uint64_t payload );
+#else
+    nKind k;
+    union
+    {
+        nInt    i;
+        nFlt    f;
+        nStr    s;
+        Hash *  hp;
+        List *  lp;
+    } u;
+#endif
+};
+
+#ifdef NODE_NANBOX
+inline nKind nVal::kind( void ) const  
+{ 
+    return (this->bits < BOX) ? FLT : nKind( (this->bits >> KIND_SHIFT) & 7 ); 
+}
+inline nInt   nVal::i( void ) const     { return nInt( this->bits << (64-KIND_SHIFT) ) >> (64-KIND_SHIFT); }
+inline nFlt   nVal::f( void ) const     { nFlt v; memcpy( &v, &this->bits, sizeof( v ) ); return v; }
+inline nStr   nVal::s( void ) const     { return reinterpret_cast<nStr>( this->bits & PAYLOAD_MASK ); }
+inline Hash * nVal::hp( void ) const    { return reinterpret_cast<Hash *>( this->bits & PAYLOAD_MASK ); }
+inline List * nVal::lp( void ) const    { return reinterpret_cast<List *>( this->bits & PAYLOAD_MASK ); }
+
+inline void nVal::box( nKind kind, uint64_t payload )
+{
+    if ( (nInt( payload << (64-KIND_SHIFT) ) >> (64-KIND_SHIFT)) != nInt( payload ) ) {
+        char msg[80];
+        snprintf( msg, sizeof( msg ), "value 0x%lx of kind %d does not fit in a NaN-boxed nVal", long( payload ), kind );
+        error( msg );
+    }
+    this->bits = BOX | (uint64_t( kind ) << KIND_SHIFT) | (payload & PAYLOAD_MASK);
+}
+
+inline void nVal::undef( void )         { this->box( UNDEF, 0 ); }
+inline void nVal::i( nInt v )           { this->box( INT, uint64_t( v ) ); }
+inline void nVal::f( nFlt v )           { memcpy( &this->bits, &v, sizeof( v ) ); if ( v != v ) this->bits = CANONICAL_NAN; }
+inline void nVal::s( nStr v )           { this->box( STR, reinterpret_cast<uint64_t>( v ) ); }
+inline void nVal::hp( Hash * v )        { this->box( HASH, reinterpret_cast<uint64_t>( v ) ); }
+inline void nVal::lp( List * v )        { this->box( LIST, reinterpret_cast<uint64_t>( v ) ); }
+#else
+inline nKind  nVal::kind( void ) const  { return this->k; }
+inline nInt   nVal::i( void ) const     { return this->u.i; }
+inline nFlt   nVal::f( void ) const     { return this->u.f; }
+inline nStr   nVal::s( void ) const     { return this->u.s; }
+inline Hash * nVal::hp( void ) const    { return this->u.hp; }
+inline List * nVal::lp( void ) const    { return this->u.lp; }
+
+inline void nVal::undef( void )         { this->k = UNDEF; }
+inline void nVal::i( nInt v )           { this->k = INT;  this->u.i = v; }
+inline void nVal::f( nFlt v )           { this->k = FLT;  this->u.f = v; }
+inline void nVal::s( nStr v )           { this->k = STR;  this->u.s = v; }
+inline void nVal::hp( Hash * v )        { this->k = HASH; this->u.hp = v; }
+inline void nVal::lp( List * v )        { this->k = LIST; this->u.lp = v; }
+#endif
+
+//---------------------------------------
+// Well-Known Property IDs
+//
+// These names are interned before any others, in this order,
+// so their ids are compile-time constants (Hash::id_kind, Hash::id_x, ...).
+// Append new names at the end.
+//---------------------------------------
+#define NODE_WELL_KNOWN_IDS( X ) \
+    X( line )   \
+    X( kind )   \
+    X( shape )  \
+    X( color )  \
+    X( index )  \
+    X( x )      \
+    X( y )      \
+    X( z )      \
+    X( w )      \
+    X( h )      \
+    X( d )      \
+
+//---------------------------------------
+// Property ID With Inline Cache
+//
+// Pass one of these instead of a plain id to the Hash getters to remember 
+// where the property was last found.  When the next shaped Hash has the same
+// shape, the lookup is a pointer compare and an index.  One per thread.
+//---------------------------------------
+class nProp
+{
+public:
+    explicit nProp( int _id = -1 ) : id( _id ), shape( nullptr ), slot( 0 ) {}
+
+    int             id;
+    const nShape *  shape;              // shape it was last found in
+    int             slot;               // and at which slot
+};
+
+//---------------------------------------
+// Occupancy Statistics
+//
+// Filled in by Hash::stats() and List::stats(), which add to what
+// is already there, so one nStats can sum over a whole tree.  A hash or
+// list reached more than once (shared by dedupe, say) is counted once.
+// Resizes are process-wide, so they come from Hash::resize_cnt() and
+// List::resize_cnt() instead.
+//---------------------------------------
+class nStats
+{
+public:
+    nStats( void );
+    ~nStats();
+
+    nStats( const nStats& ) = delete;
+    nStats& operator = ( const nStats& ) = delete;
+
+    static const int PROBE_HIST_LEN = 16;
+
+    long    hash_cnt;                           // hashes
+    long    hash_inline_cnt;                    // of those, still inline
+    long    hash_shaped_cnt;                    // of those, sharing a shape
+    long    hash_prop_cnt;                      // properties
+    long    hash_slot_cnt;                      // slots allocated (inline hashes count INLINE_CNT)
+    long    hash_probe_hist[PROBE_HIST_LEN];    // properties by distance from home slot, last bucket is that or more
+    long    hash_bytes;                         // objects plus tables
+    long    list_cnt;                           // lists
+    long    list_packed_cnt;                    // of those, packed INT or FLT
+    long    list_entry_cnt;                     // entries
+    long    list_alloc_cnt;                     // entries allocated
+    long    list_bytes;                         // objects plus entry arrays
+    long    str_bytes;                          // string values, including NULs
+    long    parse_node_cnt;                     // hashes and lists parsed (see NodeIO::stats())
+    long    parse_shared_cnt;                   // of those, replaced by an identical earlier one
+
+    void    val_add( const nVal& v, bool tree );// add what a value points to
+    double  hash_load( void ) const;            // properties / slots
+    double  hash_probe_avg( void ) const;
+    const nStats& print( nStr s = "" ) const;
+
+private:
+    friend class Hash;
+    friend class List;
+
+    const void ** seen;                         // hashes and lists counted so far, open-addressed
+    long    seen_mask;                          // allocated entries-1
+    long    seen_cnt;                           // entries used
+
+    bool    node_first( const void * node );    // true the first time node is counted
+};
 
 //---------------------------------------
 // Hash
@@ -55,11 +258,19 @@ class List;
 class Hash 
 {
 public:
-    Hash( void );
+    Hash( bool shaped = false, nArena * arena = nullptr );  // shaped hashes share their key layout with other hashes (see Hash.cpp)
     ~Hash();
 
+    #define NODE_ID_ENUM( name ) id_##name,
+    enum { NODE_WELL_KNOWN_IDS( NODE_ID_ENUM ) id_well_known_cnt };
+    #undef NODE_ID_ENUM
+
     static int  str_to_id( nStr s );  // map string to unique property id which is used in all routines below
     static nStr id_to_str( int id );  // map unique property back to string (better exist)
+    static nStr str_pooled( nStr s ); // shared immutable copy of s, never freed, even with the arena; equal strings give the same pointer
+
+    Hash& reserve( int cnt );   // make room for cnt properties without further resizing
+    Hash& shrink_to_fit( void );// release unused table space
 
     bool  exists( int id );
     bool  defined( int id );
@@ -70,6 +281,7 @@ public:
     Hash& i( int id, nInt v );
     Hash& f( int id, nFlt v );
     Hash& s( int id, nStr v );
+    Hash& sp( int id, nStr v );   // store v itself rather than a copy, so v must outlive the hash
     Hash& hp( int id, Hash * v );
     Hash& lp( int id, List * v );
 
@@ -81,14 +293,66 @@ public:
     List& l( int id );
     List* lp( int id );
 
+    nInt  i( nProp& p );        // same, with an inline cache
+    nFlt  f( nProp& p );
+    nStr  s( nProp& p );
+    Hash& h( nProp& p );
+    Hash* hp( nProp& p );
+    List& l( nProp& p );
+    List* lp( nProp& p );
+
     int   id_first( int& hdl ); // property iteration
     int   id_next( int& hdl );
 
     Hash& print( nStr s = "" );
+    Hash& stats( nStats& st, bool tree = true );    // add occupancy stats, and those of nested values if tree
+    static long resize_cnt( void );                 // process-wide table rebuilds so far
+
+    bool     equal( Hash& other );      // same properties with same() values, in any order
+    uint64_t digest( void );            // order-independent hash of the same
+
+    Hash( const Hash& ) = delete;               // small hashes point into themselves
+    Hash& operator = ( const Hash& ) = delete;
 
 private:
-    class Impl;
-    Impl * impl;
+    friend class nImage;                        // writes and maps hashes as they are laid out here
+    friend class NodeIOWriter;                  // walks the entries directly
+
+    //---------------------------------------
+    // Up to INLINE_CNT properties are kept in the object itself as a dense
+    // array that is searched all at once.  The ids either live in the object
+    // (MASK_INLINE) or in a shared shape (MASK_SHAPED).  After that they move
+    // to a heap-allocated probe table (see Hash.cpp).
+    //---------------------------------------
+    static const int INLINE_CNT  = 8;
+    static const int MASK_INLINE = -1;
+    static const int MASK_SHAPED = -2;
+
+    int     count;                      // entries used
+    int     mask;                       // allocated table entries-1, or MASK_INLINE or MASK_SHAPED
+    nArena *arena;                      // where tables and strings come from, or nullptr for the heap
+    int *   ids;                        // id of each entry, -1 means unused
+    nVal *  vals;                       // value of each entry
+    union
+    {
+        int      inline_ids[INLINE_CNT];
+        nShape * shape;
+    };
+    nVal    inline_vals[INLINE_CNT];
+
+    int     slot_dist( int id, int i );
+    void    slot_id_set( int i, int id );
+    int     slot_find( int id );
+    nVal *  slot_insert( int id, const nVal& val );
+    void    slot_remove( int id );
+    void    table_alloc( int cnt );
+    void    table_rebuild( int cnt );
+    static int table_cnt( int cnt );
+    void    shape_leave( void );
+    void    ids_remap( const int * id_map );    // replace each id with id_map[id], in place
+    nVal *  val_get( int id, nKind kind = UNDEF );
+    nVal *  val_get( nProp& p, nKind kind );
+    nVal *  val_set( int id );
 };
 
 //---------------------------------------
@@ -100,9 +364,17 @@ private:
 class List
 {
 public:
-    List( void );
+    List( nArena * arena = nullptr );
+    List( const nVal * vals, int cnt, nArena * arena = nullptr );  // bulk build from cnt values in one allocation
     ~List();
 
+    List&  reserve( int cnt );             // make room for cnt entries without further resizing
+    List&  shrink_to_fit( void );          // release unused space
+
+    nKind  packed_kind( void );            // INT or FLT if all entries are that kind and stored packed, else UNDEF
+    nInt * ip( void );                     // the packed entries as a plain array, or nullptr if not packed INT
+    nFlt * fp( void );                     // the packed entries as a plain array, or nullptr if not packed FLT
+
     int    length( void );
     bool   exists( int i );
     bool   defined( int i );
@@ -152,10 +424,194 @@ public:
     List* shiftlp( void );
 
     List& print( nStr s = "" );
+    List& stats( nStats& st, bool tree = true );    // add occupancy stats, and those of nested values if tree
+    static long resize_cnt( void );                 // process-wide entry reallocations so far
+
+    bool     equal( List& other );      // same length with same() entries
+    uint64_t digest( void );            // hash of the same
+
+    List( const List& ) = delete;               // small lists point into themselves
+    List& operator = ( const List& ) = delete;
 
 private:
-    class Impl;
-    Impl * impl;
+    friend class nImage;                        // writes and maps lists as they are laid out here
+    friend class NodeIOWriter;                  // walks the entries directly
+
+    //---------------------------------------
+    // Up to INLINE_CNT entries (twice that many packed) are kept in the object itself.
+    //---------------------------------------
+    static const int INLINE_CNT = 4;
+
+    int     count;                      // entries used
+    int     alloc_count;                // allocated entries
+    int     head;                       // free entries in front of entries[0] (see List.cpp)
+    nKind   packed;                     // INT or FLT if stored as ints[] or flts[], else UNDEF
+    nArena *arena;                      // where entry arrays come from, or nullptr for the heap
+    union
+    {
+        nVal *  entries;                // first used entry
+        nInt *  ints;                   // same, when packed INT
+        nFlt *  flts;                   // same, when packed FLT
+        char *  bytes;
+    };
+    nVal    inline_entries[INLINE_CNT];
+
+    char *  block_alloc( int len );
+    void    block_free( char * base );
+    int     entry_len( void );
+    char *  entries_base( void );
+    bool    entries_inline( void );
+    nVal *  entry_get( int i, nKind kind = UNDEF );
+    nVal *  entry_set( int i );
+    nVal    entry_val( int i );
+    bool    packed_set( int i, nKind kind );
+    void    room_make( int i );
+    void    entries_realloc( int cnt, int head );
+    void    entries_move( int head );
+    void    repack( nKind kind );
+    void    unpack( void );
+    void    shift_up( void );
+    void    shift_down( void );
+};
+
+//---------------------------------------
+// Arena
+//
+// Bump allocator for a whole document.  Hashes and lists made by 
+// hash_new()/list_new() get their tables, entry arrays and string values 
+// from the arena too, and none of it is freed until the arena is deleted.
+// Never delete such a Hash or List yourself.
+//---------------------------------------
+class nArena
+{
+public:
+    nArena( int block_len = 1 << 20 );
+    ~nArena();                                  // frees everything allocated from this arena
+
+    void * alloc( size_t len );                 // 8-byte aligned
+    nStr   strdup( nStr s );
+    Hash * hash_new( bool shaped = false );
+    List * list_new( void );
+    List * list_new( const nVal * vals, int cnt );
+    long   bytes( void );                       // bytes obtained from the heap so far
+
+    class Mark                                  // allocation state, for release()
+    {
+    public:
+        char *  blocks;
+        char *  pos;
+        char *  end;
+        long    total;
+    };
+    Mark   mark( void );
+    void   release( const Mark& m );            // give back everything allocated since m
+
+    void   map_adopt( void * addr, size_t len, nArena * inner = nullptr );  // munmap() this along with the arena, after deleting inner, an arena placed in it
+    void   adopt( nArena& other );              // take over everything other holds, leaving it empty; its blocks count as allocated now
+
+    nArena( const nArena& ) = delete;
+    nArena& operator = ( const nArena& ) = delete;
+
+private:
+    int     block_len;                          // normal block size
+    char *  blocks;                             // most recent block; each starts with a pointer to the previous one
+    char *  pos;                                // next free byte in current block
+    char *  end;                                // end of current block
+    long    total;                              // bytes obtained from the heap
+    class Map;
+    Map *   maps;                               // adopted mappings
+
+    char *  block_new( size_t len );
+};
+
+//---------------------------------------
+// Node Image
+//
+// A Hash or List tree saved as it sits in memory, so that opening it is
+// an mmap() and the nodes are used in place (see NodeImage.cpp).  
+// NodeIO recognizes image files: list_parse() or hash_parse() returns
+// the root, and the arena (which is required) keeps the mapping.
+//---------------------------------------
+class nImage
+{
+public:
+    static void     write( const char * file_path, List * list );  // exits on error
+    static void     write( const char * file_path, Hash * hash );
+
+    static nImage * open( const char * file_path );    // map file_path if it is an image, else nullptr
+    ~nImage();                                          // unmaps it, unless root() gave it to an arena
+    nVal            root( nArena * arena, bool str_pool = false );    // the tree, in place; arena takes over the mapping; str_pool as NodeIO::str_pool_set()
+
+    nImage( const nImage& ) = delete;
+    nImage& operator = ( const nImage& ) = delete;
+
+private:
+    nImage( void ) {}
+
+    char *          addr;                       // where the image is mapped
+    size_t          len;                        // file length
+    bool            adopted;                    // root() handed the mapping to an arena
+
+    class Writer;
+    static void     write( const char * file_path, const nVal& root );
+    static void     val_fix( nVal& v, intptr_t delta, bool str_pool );
+    static void     hash_fix( Hash * hash, intptr_t delta, const int * id_map, bool str_pool );
+    static void     list_fix( List * list, intptr_t delta, bool str_pool );
+};
+
+//---------------------------------------
+// Node Index
+//
+// A sidecar file_path.idx holding where each element of the top-level
+// list starts in file_path and, if it is gzipped or zstd-compressed, 
+// places decompression can restart from (see NodeIndex.cpp).  NodeIO picks up an up-to-date one
+// for elem_seek() and list_parse( first, cnt ).
+//---------------------------------------
+class nIndex
+{
+public:
+    static void     write( const char * file_path, long span = 1 << 20 );    // scan file_path into file_path.idx, a restart point every span bytes; exits on error
+    static nIndex * open( const char * file_path );    // map file_path.idx if it is there and up to date, else nullptr
+    ~nIndex();
+
+    long            elem_cnt( void );                   // elements in the top-level list
+    long            elem_off( long k );                 // text offset of element k, just past the '[' or ',' before it
+    int             elem_line( long k );                // line number there
+    bool            compressed( void );                 // restart points are needed to get there
+    void            seek( long off );                   // compressed: read() goes on from text offset off
+    int             read( char * buf, int len );        // compressed: up to len more bytes of text, 0 at the end
+
+    nIndex( const nIndex& ) = delete;
+    nIndex& operator = ( const nIndex& ) = delete;
+
+private:
+    nIndex( void ) {}
+
+    char *          addr;                       // where the index is mapped
+    size_t          len;                        // index file length
+    class Stream;
+    Stream *        stream;                     // decompresses file_path, when compressed
+};
+
+//---------------------------------------
+// NodeIO Events
+//
+// Callbacks for NodeIO::events_parse(), in document order.  Each returns
+// false to stop the parse.  The defaults ignore the event.
+//---------------------------------------
+class NodeIOEvents
+{
+public:
+    virtual ~NodeIOEvents() {}
+
+    virtual bool list_begin( void )     { return true; }
+    virtual bool list_end( void )       { return true; }
+    virtual bool hash_begin( void )     { return true; }
+    virtual bool hash_end( void )       { return true; }
+    virtual bool key( int id )          { return true; }    // property name, as from Hash::str_to_id()
+    virtual bool i( nInt v )            { return true; }
+    virtual bool f( nFlt v )            { return true; }
+    virtual bool s( nStr v )            { return true; }    // only valid during the call
 };
 
 //---------------------------------------
@@ -167,8 +623,65 @@ public:
     NodeIO( const char * file_path );
     ~NodeIO();
 
+    void   shaped_set( bool shaped );   // parse hashes as shaped hashes (default: false)
+    void   arena_set( nArena * arena ); // allocate everything parsed from this arena (default: heap)
+    void   str_pool_set( bool pool );   // use Hash::str_pooled() for string values, which are never freed, so only for repetitive ones (default: false)
+    void   dedupe_set( bool dedupe );   // share identical hashes and lists (default: false, see NodeIO.cpp)
+    void   str_in_place_set( bool in_place ); // string values point into the mapped file, unless it has an index (default: false, see NodeIO.cpp)
+    void   threads_set( int cnt );      // list_parse() splits the top-level list over cnt threads, and gzip members inflate on them, 0 = all cores (default: 1, see NodeIO.cpp)
+    bool   mapped( void );              // the file is uncompressed and read through mmap()
+
+    static const char * scanner( void );  // "avx2", "sse2" or "scalar" (see NodeIO.cpp)
+    static nCodec codec( const char * file_path );    // how the file is compressed, from its first bytes
+    static bool   codec_built( nCodec codec );        // this build can read and write it
+    void   stats( nStats& st );         // add parse stats
+
     List * list_parse( void );
     Hash * hash_parse( void );
+    bool   events_parse( NodeIOEvents& events );   // one value as events, building nothing; false if stopped
+    bool   elem_next( nVal& v );        // next element of the top-level list, false after the last (see NodeIO.cpp)
+    long   elem_cnt( void );            // elements in the top-level list, from the file's nIndex; -1 without one
+    void   elem_seek( long k );         // elem_next() returns element k next; needs an nIndex
+    List * list_parse( long first, long cnt );    // up to cnt elements of the top-level list from first on; needs an nIndex
+    long   token_cnt( void );           // scan the rest of the file without building anything; returns tokens seen
+
+private:
+    class Impl;
+    Impl * impl;
+};
+
+//---------------------------------------
+// STATIC: NodeIOWriter
+//
+// Writes text that NodeIO reads back (see NodeIOWriter.cpp).  Whole trees
+// go out with hash_write() or list_write().  Anything too big to build
+// can be streamed through the NodeIOEvents calls instead, which also lets
+// NodeIO::events_parse() copy a file straight into a writer.
+//---------------------------------------
+class NodeIOWriter : public NodeIOEvents
+{
+public:
+    NodeIOWriter( const char * file_path, int level = 0, nCodec codec = CODEC_GZIP );    // level 0 writes plain text, else codec's level (see NodeIOWriter.cpp)
+    ~NodeIOWriter();                    // flushes and closes the file
+
+    void   threads_set( int cnt );      // zstd compresses on cnt threads, 0 = all cores (default: 1)
+
+    void   hash_write( Hash * hash );   // a whole hash, as the next value
+    void   list_write( List * list );   // a whole list, as the next value
+    void   val_write( const nVal& v );  // any value but UNDEF
+    long   text_len( void );            // chars written so far, before compression
+
+    bool   list_begin( void );
+    bool   list_end( void );
+    bool   hash_begin( void );
+    bool   hash_end( void );
+    bool   key( int id );               // property name; its value comes next
+    bool   i( nInt v );
+    bool   f( nFlt v );
+    bool   s( nStr v );
+
+    NodeIOWriter( const NodeIOWriter& ) = delete;
+    NodeIOWriter& operator = ( const NodeIOWriter& ) = delete;
 
 private:
     class Impl;
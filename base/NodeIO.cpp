@@ -27,6 +27,21 @@
 #include "errno.h"
 #include "math.h"
 #include "assert.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#ifdef NODEIO_ZSTD
+#include <zstd.h>
+#endif
+#ifdef NODEIO_LZ4
+#include <lz4frame.h>
+#endif
 
 #undef dprintf
 #define dprintf if ( 0 ) printf
@@ -34,8 +49,12 @@
 //--------------------------------------------
 // Internal Implementation Structure
 //--------------------------------------------
-const int LINE_LEN = 1024;
-const int MSG_LEN  = 2*LINE_LEN;
+const int BLOCK_LEN = 1 << 20;        // initial gzread() size
+const int SCAN_PAD  = 64;             // readable bytes needed past a buffer's NUL (see Character Runs)
+const int MSG_LEN   = 256;
+const int CHUNK_MIN = 256 << 10;      // smallest input worth handing to another thread
+const int ZBUF_LEN  = 1 << 17;        // zstd or lz4 input read at a time
+const size_t MEMBER_MAX = 32 << 20;   // most text a gunzip worker holds for one member (see Parallel gunzip)
 
 enum 
 {
@@ -55,91 +74,341 @@ enum
     TOK_COLON   = 13
 };
 
+class SharedNode
+{
+public:
+    uint64_t            digest;                                                         // Hash::digest() or List::digest()
+    void *              node;                                                           // Hash or List, nullptr means unused
+    bool                is_list;                                                        
+};
+
+class Gunzip                                                                            // see Parallel gunzip
+{
+public:
+    static Gunzip *     open( int fd, int thread_cnt );                                 // nullptr if the file can't be mapped
+    ~Gunzip();
+
+    int                 read( char * to, int len );                                     // like gzread(), 0 at the end
+
+private:
+    enum { PENDING, RUNNING, DONE, FAILED, TOO_BIG };
+
+    class Member
+    {
+    public:
+        size_t              start;                                                      // offset of its gzip header
+        size_t              end;                                                        // offset past its trailer, once DONE
+        char *              out;                                                        // its text, once DONE
+        size_t              out_len;                                                    // length of that
+        int                 state;                                                      // PENDING, RUNNING, DONE, FAILED or TOO_BIG
+        std::atomic<bool>   cancel;                                                     // not wanted anymore, the worker deletes it
+    };
+
+    const uint8_t *     map;                                                            // whole gzip file
+    size_t              map_len;                                                        // its length
+    size_t              pos;                                                            // start of the member being read, or the next one
+    size_t              scan_off;                                                       // candidate headers are looked for from here on
+    bool                done;                                                           // no member at pos
+    Member *            cur;                                                            // DONE member whose text read() is handing out
+    size_t              cur_pos;                                                        // next char of it
+    bool                streaming;                                                      // read() is inflating the member at pos itself
+    z_stream            strm;                                                           // for that
+    size_t              in_off;                                                         // next input byte of it
+    std::deque<Member *> members;                                                       // candidates from pos on, in file order
+    int                 ahead;                                                          // most candidates to have in members
+    std::mutex          mutex;                                                          // guards members and states
+    std::condition_variable cond;                                                       // a member was added or finished
+    bool                stopping;                                                       // workers should exit
+    std::thread **      workers;
+    int                 worker_cnt;
+
+    void                member_next( size_t end );                                      // the member at pos ended at end
+    void                member_start( void );                                           // find how to read the member at pos
+    void                members_top_up( void );                                         // add candidates after scan_off, mutex held
+    int                 stream( char * to, int len );                                   // inflate the member at pos into to
+    void                worker( void );                                                 // inflate candidates until stopping
+    static int          member_inflate( const uint8_t * in, size_t in_len, Member * m );// DONE, FAILED or TOO_BIG
+};
+
 class NodeIO::Impl
 {
 public:
+    Impl( void );
+    ~Impl();
+
     //------------------------------------------------------------
     // NodeIO Info
     //------------------------------------------------------------
-    gzFile              file_hdl;                                                       // open file hdl
-    char                line[LINE_LEN];                                                 // current line being parsed
-    int                 line_pos;                                                       // position in current line
+    nImage *            image;                                                          // node image, instead of text
+    nIndex *            index;                                                          // file's index, if it has an up-to-date one
+    bool                index_read;                                                     // block_read() decompresses through index, since a seek
+    gzFile              file_hdl;                                                       // open file hdl, unless mapped or zstd or lz4
+    nCodec              codec;                                                          // how the file is compressed
+    int                 fd;                                                             // compressed file
+    Gunzip *            gunzip;                                                         // inflates gzip members on several threads, once threads_set()
+    char *              zbuf;                                                           // its input, not yet decoded
+    int                 zbuf_pos;                                                       // next byte to decode
+    int                 zbuf_end;                                                       // end of data in zbuf
+    bool                zframe_open;                                                    // the last frame decoded hasn't ended
+#ifdef NODEIO_ZSTD
+    ZSTD_DCtx *         zstd;
+#endif
+#ifdef NODEIO_LZ4
+    LZ4F_dctx *         lz4;
+#endif
+    char *              map;                                                            // whole file, if uncompressed
+    size_t              map_len;                                                        // mapped length, past the end of the file
+    bool                str_in_place;                                                   // string values may point into map
+    bool                map_used;                                                       // some do, so the arena must keep map
+    char *              token_in_place;                                                 // current string token in map, if any
+    char *              buf;                                                            // current block, plus room for a NUL
+    int                 buf_len;                                                        // allocated block length
+    char *              buf_pos;                                                        // next char to scan
+    char *              buf_end;                                                        // end of data in the block, always a NUL
+    bool                eof;                                                            // nothing left to read
+    int                 line_num;                                                       // line of buf_pos, for messages
     int                 token;                                                          // current token kind, if any
-    char                token_str[LINE_LEN];                                            // current token string, if relevant
+    char *              token_str;                                                      // current token string, if relevant
+    int                 token_str_alloc;                                                // allocated length of token_str
     nInt                token_int;                                                      // when token is an int
     nFlt                token_flt;                                                      // when token is a flt
+    bool                shaped;                                                         // create shaped hashes
+    nArena *            arena;                                                          // allocate from here, if not nullptr
+    bool                str_pool;                                                       // share string values through Hash::str_pooled()
+    nVal *              scratch;                                                        // stack of list elements still being parsed
+    int                 scratch_cnt;                                                    // entries in use
+    int                 scratch_alloc;                                                  // entries allocated
+    bool                dedupe;                                                         // share identical hashes and lists
+    SharedNode *        shared;                                                         // every distinct node parsed so far, when dedupe
+    int                 shared_mask;                                                    // allocated entries-1
+    int                 shared_cnt;                                                     // entries used
+    long                node_cnt;                                                       // hashes and lists parsed
+    long                shared_hit_cnt;                                                 // of those, replaced by a shared one
+    int                 thread_cnt;                                                     // list_parse() splits the top-level list this many ways
+
+    nVal *              scratch_push( void );                                           // push one list element
+    nStr                str_dup( nStr s );                                              // copy string value
+    void *              shared_find( void * node, bool is_list );                       // earlier identical node, else adds this one
+    Hash *              hash_share( Hash * hash, const nArena::Mark& mark );            // hash or an earlier identical one
+    List *              list_share( List * list, const nArena::Mark& mark );            // list or an earlier identical one
 
     List *              list_parse();                                                   // parse list
+    List *              list_parse_parallel();                                          // parse the top-level list on thread_cnt threads
+    int                 chunks_split( int cnt, char ** starts, int * lines );           // top-level element boundaries, 0 if not worth it
+    void                chunk_parse();                                                  // parse comma-separated elements onto scratch
+    void                all_read();                                                     // read the rest of the file into buf
+    nVal                image_root( nKind kind );                                       // root of the image, which must be of this kind
+    void                text_only( const char * what );                                 // error if this is an image
     Hash *              hash_parse();                                                   // parse hash
     int                 token_peek();                                                   // parse one token
+    int                 token_scan();                                                   // scan one token from the block, TOK_NONE if it needs more
+    void                token_str_fit( int len );                                       // make room for len chars plus NUL
     bool                token_peek_eq( int tok );                                       // return true if next token is this
     void                token_expect( int tok );                                        // dassertion and consumption of token
 
-    bool                getline( void );                                                // get one line
+    int                 elem_state;                                                     // elem_next(): 0 before '[', 1 inside, 2 after ']'
+
+    bool                val_parse( nVal& v );                                           // parse one list element, false if there's none
+    bool                events_val( NodeIOEvents& ev );                                 // parse one value as events, false if stopped
+    bool                elem_next( nVal& v );                                           // next top-level list element
+    void                elem_seek( long k );                                            // elem_next() goes on from element k
+
+    void                block_read( void );                                             // read next block
+    bool                file_map( const char * file_path );                            // mmap() the file if it's not compressed
+    void                codec_open( const char * file_path );                           // start reading a zstd or lz4 file
+    void                codec_close( void );
+    int                 codec_read( char * to, int len );                               // decode up to len chars, 0 at the end
+    nStr                str_value( void );                                              // string token as a value
 };
 
 //----------------------------------------------------------------
 // Initialization
 //----------------------------------------------------------------
+NodeIO::Impl::Impl( void )
+{
+    this->image = nullptr;
+    this->index = nullptr;
+    this->index_read = false;
+    this->file_hdl = nullptr;
+    this->codec = CODEC_NONE;
+    this->fd = -1;
+    this->gunzip = nullptr;
+    this->zbuf = nullptr;
+    this->map = nullptr;
+    this->map_len = 0;
+    this->str_in_place = false;
+    this->map_used = false;
+    this->token_in_place = nullptr;
+    this->buf = nullptr;
+    this->buf_len = 0;
+    this->buf_pos = nullptr;
+    this->buf_end = nullptr;
+    this->eof = true;
+    this->line_num = 1;
+    this->token = TOK_NONE;
+    this->elem_state = 0;
+    this->token_str_alloc = 256;
+    this->token_str = new char[this->token_str_alloc];
+    this->shaped = false;
+    this->arena = nullptr;
+    this->str_pool = false;
+    this->scratch_alloc = 1024;
+    this->scratch_cnt = 0;
+    this->scratch = new nVal[this->scratch_alloc];
+    this->dedupe = false;
+    this->shared = nullptr;
+    this->shared_mask = -1;
+    this->shared_cnt = 0;
+    this->node_cnt = 0;
+    this->shared_hit_cnt = 0;
+    this->thread_cnt = 1;
+}
+
 NodeIO::NodeIO( const char * file_path )
 {
     impl = new NodeIO::Impl();
 
-    impl->file_hdl = gzopen( file_path, "r" );
-    if ( !impl->file_hdl ) {
-         char msg[MSG_LEN];
-         sprintf( msg, "could not open file %s for reading, errno=%d", file_path, errno );
-         error( msg );
-    }
+    impl->image = nImage::open( file_path );
+    if ( impl->image == nullptr && !impl->file_map( file_path ) ) {
+        impl->codec = NodeIO::codec( file_path );
+        if ( impl->codec == CODEC_ZSTD || impl->codec == CODEC_LZ4 ) {
+            impl->codec_open( file_path );
+        } else {
+            impl->file_hdl = gzopen( file_path, "r" );
+            if ( !impl->file_hdl ) {
+                 char msg[MSG_LEN];
+                 snprintf( msg, MSG_LEN, "could not open file %s for reading, errno=%d", file_path, errno );
+                 error( msg );
+            }
 
-    impl->line[0] = '\0';
-    impl->line_pos = 0;
-    impl->token = TOK_NONE;
+            //---------------------------------------
+            // Only for inflating on several threads (see threads_set()), 
+            // which is skipped if this fails.
+            //---------------------------------------
+            if ( impl->codec == CODEC_GZIP ) impl->fd = open( file_path, O_RDONLY );
+        }
+
+        impl->buf_len = BLOCK_LEN;
+        impl->buf = new char[impl->buf_len+1+SCAN_PAD];
+        impl->buf_pos = impl->buf;
+        impl->buf_end = impl->buf;
+        *impl->buf_end = '\0';
+        impl->eof = false;
+    }
+    if ( impl->image == nullptr ) impl->index = nIndex::open( file_path );
 }
 
 //----------------------------------------------------------------
 // Destructor
 //----------------------------------------------------------------
+NodeIO::Impl::~Impl()
+{
+    delete[] this->token_str;
+    delete[] this->scratch;
+    delete[] this->shared;
+}
+
 NodeIO::~NodeIO()
 {
-    gzclose( impl->file_hdl );
+    if ( impl->image != nullptr ) {
+        delete impl->image;
+    } else if ( impl->map != nullptr ) {
+        if ( impl->map_used ) {
+            impl->arena->map_adopt( impl->map, impl->map_len );
+        } else {
+            munmap( impl->map, impl->map_len );
+        }
+    } else {
+        if ( impl->file_hdl != nullptr ) {
+            delete impl->gunzip;
+            gzclose( impl->file_hdl );
+            if ( impl->fd >= 0 ) close( impl->fd );
+        } else {
+            impl->codec_close();
+        }
+        delete[] impl->buf;
+    }
+    delete impl->index;
     delete impl;
     this->impl = nullptr;
 }
 
+//----------------------------------------------------------------
+// Options
+//----------------------------------------------------------------
+void NodeIO::shaped_set( bool shaped )
+{
+    impl->shaped = shaped;
+}
+
+void NodeIO::arena_set( nArena * arena )
+{
+    impl->arena = arena;
+}
+
+void NodeIO::str_pool_set( bool pool )
+{
+    impl->str_pool = pool;
+}
+
+void NodeIO::dedupe_set( bool dedupe )
+{
+    impl->dedupe = dedupe;
+}
+
+void NodeIO::str_in_place_set( bool in_place )
+{
+    impl->str_in_place = in_place;
+}
+
+void NodeIO::threads_set( int cnt )
+{
+    if ( cnt <= 0 ) cnt = std::thread::hardware_concurrency();
+    impl->thread_cnt = (cnt > 0) ? cnt : 1;
+    if ( impl->thread_cnt > 1 && impl->gunzip == nullptr && impl->fd >= 0 && impl->file_hdl != nullptr && 
+         !impl->index_read && gztell( impl->file_hdl ) == 0 ) {
+        impl->gunzip = Gunzip::open( impl->fd, impl->thread_cnt );
+    }
+}
+
+bool NodeIO::mapped( void )
+{
+    return impl->map != nullptr || impl->image != nullptr;
+}
+
+void NodeIO::stats( nStats& st )
+{
+    st.parse_node_cnt += impl->node_cnt;
+    st.parse_shared_cnt += impl->shared_hit_cnt;
+}
+
 //----------------------------------------------------------------
 // Parses an entire list.
 //----------------------------------------------------------------
 List * NodeIO::list_parse()
 {
-    return impl->list_parse();
+    if ( impl->image != nullptr ) return impl->image_root( LIST ).lp();
+    return (impl->thread_cnt > 1) ? impl->list_parse_parallel() : impl->list_parse();
 }
 
 List * NodeIO::Impl::list_parse( void )
 {
+    //---------------------------------------
+    // Elements collect on the scratch stack (nested lists stack above us)
+    // and the List is built once at the end with its exact size, 
+    // so long lists don't grow-and-copy their way up.
+    // Use indexes, not pointers, since nested parses may realloc the stack.
+    //---------------------------------------
     dprintf( "begin list_parse()\n" );
-    List * list = new List();
+    nArena::Mark mark = {};
+    if ( this->arena != nullptr ) mark = this->arena->mark();
+    int start = this->scratch_cnt;
     this->token_expect( TOK_LSQUARE );
     for( ;; )
     {
         dprintf( "tok=%d\n", token_peek() );
-        if ( this->token_peek_eq( TOK_LCURLY ) ) {
-            list->pushhp( this->hash_parse() );
-        } else if ( this->token_peek_eq( TOK_LSQUARE ) ) {
-            list->pushlp( this->list_parse() );
-        } else if ( this->token_peek_eq( TOK_ID ) ) {
-            list->pushs( this->token_str );
-            this->token_expect( TOK_ID );
-        } else if ( this->token_peek_eq( TOK_STR ) ) {
-            list->pushs( this->token_str );
-            this->token_expect( TOK_STR );
-        } else if ( this->token_peek_eq( TOK_INT ) ) {
-            list->pushi( this->token_int );
-            this->token_expect( TOK_INT );
-        } else if ( this->token_peek_eq( TOK_FLT ) ) {
-            list->pushf( this->token_flt );
-            this->token_expect( TOK_FLT );
-        }
+        nVal v;
+        if ( this->val_parse( v ) ) *this->scratch_push() = v;
         if ( this->token_peek_eq( TOK_COMMA ) ) {
             this->token_expect( TOK_COMMA );
         } else {
@@ -147,8 +416,52 @@ List * NodeIO::Impl::list_parse( void )
         }
     }
     this->token_expect( TOK_RSQUARE );
+    int    cnt  = this->scratch_cnt - start;
+    List * list = (this->arena != nullptr) ? this->arena->list_new( &this->scratch[start], cnt ) : new List( &this->scratch[start], cnt );
+    this->scratch_cnt = start;
     dprintf( "end list_parse()\n" );
-    return list;
+    return this->list_share( list, mark );
+}
+
+bool NodeIO::Impl::val_parse( nVal& v )
+{
+    switch( this->token_peek() )
+    {
+        case TOK_LCURLY:    v.hp( this->hash_parse() );             return true;
+        case TOK_LSQUARE:   v.lp( this->list_parse() );             return true;
+        case TOK_ID:        v.s( this->str_dup( this->token_str ) ); break;
+        case TOK_STR:       v.s( this->str_value() );               break;
+        case TOK_INT:       v.i( this->token_int );                 break;
+        case TOK_FLT:       v.f( this->token_flt );                 break;
+        default:            return false;
+    }
+    this->token = TOK_NONE;
+    return true;
+}
+
+nStr NodeIO::Impl::str_dup( nStr s )
+{
+    if ( this->str_pool ) return Hash::str_pooled( s );
+    return (this->arena != nullptr) ? this->arena->strdup( s ) : strdup( s );
+}
+
+nStr NodeIO::Impl::str_value( void )
+{
+    if ( this->token_in_place == nullptr ) return this->str_dup( this->token_str );
+    this->map_used = true;
+    return this->token_in_place;
+}
+
+nVal * NodeIO::Impl::scratch_push( void )
+{
+    if ( this->scratch_cnt == this->scratch_alloc ) {
+        nVal * new_scratch = new nVal[this->scratch_alloc << 1];
+        memcpy( new_scratch, this->scratch, this->scratch_cnt * sizeof( nVal ) );
+        delete[] this->scratch;
+        this->scratch = new_scratch;
+        this->scratch_alloc <<= 1;
+    }
+    return &this->scratch[this->scratch_cnt++];
 }
 
 //----------------------------------------------------------------
@@ -156,13 +469,16 @@ List * NodeIO::Impl::list_parse( void )
 //----------------------------------------------------------------
 Hash * NodeIO::hash_parse()
 {
+    if ( impl->image != nullptr ) return impl->image_root( HASH ).hp();
     return impl->hash_parse();
 }
 
 Hash * NodeIO::Impl::hash_parse( void )
 {
     dprintf( "begin hash_parse()\n" );
-    Hash * hash = new Hash();
+    nArena::Mark mark = {};
+    if ( this->arena != nullptr ) mark = this->arena->mark();
+    Hash * hash = (this->arena != nullptr) ? this->arena->hash_new( this->shaped ) : new Hash( this->shaped );
     this->token_expect( TOK_LCURLY );
     for( ;; )
     {
@@ -175,10 +491,10 @@ Hash * NodeIO::Impl::hash_parse( void )
             } else if ( this->token_peek_eq( TOK_LSQUARE ) ) {
                 hash->lp( name_id, this->list_parse() );
             } else if ( this->token_peek_eq( TOK_ID ) ) {
-                hash->s( name_id, this->token_str );
+                hash->sp( name_id, this->str_dup( this->token_str ) );
                 this->token_expect( TOK_ID );
             } else if ( this->token_peek_eq( TOK_STR ) ) {
-                hash->s( name_id, this->token_str );
+                hash->sp( name_id, this->str_value() );
                 this->token_expect( TOK_STR );
             } else if ( this->token_peek_eq( TOK_INT ) ) {
                 hash->i( name_id, this->token_int );
@@ -188,7 +504,7 @@ Hash * NodeIO::Impl::hash_parse( void )
                 this->token_expect( TOK_FLT );
             } else {
                 char msg[MSG_LEN];
-                sprintf( msg, "hash field expression is unexpected: %s", this->line );
+                snprintf( msg, MSG_LEN, "hash field expression is unexpected (line %d)", this->line_num );
                 error( msg );
             }
         }
@@ -200,182 +516,871 @@ Hash * NodeIO::Impl::hash_parse( void )
     }
     token_expect( TOK_RCURLY );
     dprintf( "end hash_parse()\n" );
-    return hash;
+    return this->hash_share( hash, mark );
+}
+
+//----------------------------------------------------------------
+// Node images (see NodeImage.cpp) are used in place, so the parse
+// options don't apply to them, except that string values are still 
+// pooled, and there is nothing to stream.
+//----------------------------------------------------------------
+nVal NodeIO::Impl::image_root( nKind kind )
+{
+    nVal root = this->image->root( this->arena, this->str_pool );
+    if ( root.kind() != kind ) error( (kind == LIST) ? "node image holds a hash, not a list" : "node image holds a list, not a hash" );
+    return root;
+}
+
+void NodeIO::Impl::text_only( const char * what )
+{
+    if ( this->image == nullptr ) return;
+    char msg[MSG_LEN];
+    snprintf( msg, MSG_LEN, "%s is not supported for node images", what );
+    error( msg );
+}
+
+//----------------------------------------------------------------
+// Streaming.
+//
+// events_parse() reports a value as NodeIOEvents callbacks and builds 
+// nothing, so memory doesn't depend on the size of the document.
+//
+// elem_next() walks the top-level list, parsing one element per call
+// into v.  Hashes and lists in it are allocated as usual and belong to 
+// the caller.  With an arena, taking a mark() before each call and 
+// releasing it after using the element keeps memory at about one 
+// element's worth; that doesn't mix with dedupe, which remembers 
+// every node it has seen.
+//----------------------------------------------------------------
+bool NodeIO::events_parse( NodeIOEvents& events )
+{
+    impl->text_only( "events_parse()" );
+    return impl->events_val( events );
+}
+
+bool NodeIO::Impl::events_val( NodeIOEvents& ev )
+{
+    switch( this->token_peek() )
+    {
+        case TOK_LCURLY:
+            this->token = TOK_NONE;
+            if ( !ev.hash_begin() ) return false;
+            for( ;; )
+            {
+                if ( this->token_peek_eq( TOK_ID ) ) {
+                    int id = Hash::str_to_id( this->token_str );
+                    this->token_expect( TOK_ID );
+                    this->token_expect( TOK_COLON );
+                    if ( !ev.key( id ) || !this->events_val( ev ) ) return false;
+                }
+                if ( this->token_peek_eq( TOK_COMMA ) ) {
+                    this->token_expect( TOK_COMMA );
+                } else {
+                    break;
+                }
+            }
+            this->token_expect( TOK_RCURLY );
+            return ev.hash_end();
+
+        case TOK_LSQUARE:
+            this->token = TOK_NONE;
+            if ( !ev.list_begin() ) return false;
+            for( ;; )
+            {
+                int tok = this->token_peek();
+                if ( tok != TOK_COMMA && tok != TOK_RSQUARE && !this->events_val( ev ) ) return false;
+                if ( this->token_peek_eq( TOK_COMMA ) ) {
+                    this->token_expect( TOK_COMMA );
+                } else {
+                    break;
+                }
+            }
+            this->token_expect( TOK_RSQUARE );
+            return ev.list_end();
+
+        case TOK_ID:
+            this->token = TOK_NONE;             // token_str stays put until the next peek
+            return ev.s( this->token_str );
+
+        case TOK_STR:
+            this->token = TOK_NONE;
+            return ev.s( (this->token_in_place != nullptr) ? this->token_in_place : this->token_str );
+
+        case TOK_INT:
+            this->token = TOK_NONE;
+            return ev.i( this->token_int );
+
+        case TOK_FLT:
+            this->token = TOK_NONE;
+            return ev.f( this->token_flt );
+
+        default:
+        {
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "value expected, got token %d (line %d)", this->token, this->line_num );
+            error( msg );
+            return false;
+        }
+    }
+}
+
+bool NodeIO::elem_next( nVal& v )
+{
+    impl->text_only( "elem_next()" );
+    return impl->elem_next( v );
+}
+
+bool NodeIO::Impl::elem_next( nVal& v )
+{
+    if ( this->elem_state == 0 ) {
+        this->token_expect( TOK_LSQUARE );
+        this->elem_state = 1;
+    }
+    while( this->elem_state == 1 )
+    {
+        bool got = this->val_parse( v );
+        if ( this->token_peek_eq( TOK_COMMA ) ) {
+            this->token_expect( TOK_COMMA );
+        } else {
+            this->token_expect( TOK_RSQUARE );
+            this->elem_state = 2;
+        }
+        if ( got ) return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------
+// Random access through the file's index (see NodeIndex.cpp).
+//
+// elem_seek() drops the scanner just past the '[' or ',' in front of
+// element k, as if it had parsed up to there.  A mapped file just moves 
+// buf_pos.  A compressed one is decompressed by the index from its 
+// nearest restart point from then on, instead of by gzread() or 
+// codec_read().
+//----------------------------------------------------------------
+long NodeIO::elem_cnt( void )
+{
+    return (impl->index != nullptr) ? impl->index->elem_cnt() : -1;
+}
+
+void NodeIO::elem_seek( long k )
+{
+    impl->text_only( "elem_seek()" );
+    impl->elem_seek( k );
+}
+
+List * NodeIO::list_parse( long first, long cnt )
+{
+    impl->text_only( "list_parse( first, cnt )" );
+    nArena::Mark mark = {};
+    if ( impl->arena != nullptr ) mark = impl->arena->mark();
+    impl->elem_seek( first );
+    int start = impl->scratch_cnt;
+    nVal v;
+    for( long k = 0; k < cnt && impl->elem_next( v ); k++ )
+    {
+        *impl->scratch_push() = v;
+    }
+    int    len  = impl->scratch_cnt - start;
+    List * list = (impl->arena != nullptr) ? impl->arena->list_new( &impl->scratch[start], len ) : new List( &impl->scratch[start], len );
+    impl->scratch_cnt = start;
+    return impl->list_share( list, mark );
+}
+
+void NodeIO::Impl::elem_seek( long k )
+{
+    if ( this->index == nullptr ) error( "elem_seek() needs an index, see nIndex::write()" );
+    long cnt = this->index->elem_cnt();
+    if ( k < 0 || k > cnt ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "element %ld is out of range, the top-level list has %ld", k, cnt );
+        error( msg );
+    }
+    this->token = TOK_NONE;
+    if ( k == cnt ) {
+        this->elem_state = 2;
+        return;
+    }
+    this->elem_state = 1;
+    this->line_num = this->index->elem_line( k );
+
+    long off = this->index->elem_off( k );
+    if ( this->map != nullptr ) {
+        this->buf_pos = this->buf + off;
+        return;
+    }
+    if ( this->index->compressed() ) {
+        this->index->seek( off );
+        this->index_read = true;
+    } else if ( gzseek( this->file_hdl, off, SEEK_SET ) != off ) {
+        error( "could not seek in file" );
+    }
+    this->buf_pos = this->buf;
+    this->buf_end = this->buf;
+    *this->buf_end = '\0';
+    this->eof = false;
+}
+
+//----------------------------------------------------------------
+// Hash-consing.
+//
+// With dedupe on, every finished hash or list is looked up among those
+// parsed before it and, if an identical one exists, that one is returned 
+// instead.  Children finish first, so identical subtrees are already the 
+// same object by the time their parent is compared, and a shallow 
+// Hash::equal() or List::equal() suffices.  
+//
+// A duplicate can only point at children that existed before it was 
+// started, so everything allocated for it can be given back: the arena
+// is released to the mark taken when the node began; on the heap the 
+// node and its unpooled strings are freed.
+//
+// Shared nodes may have many parents, so callers must treat the 
+// result as immutable.
+//----------------------------------------------------------------
+void * NodeIO::Impl::shared_find( void * node, bool is_list )
+{
+    uint64_t digest = is_list ? static_cast<List *>( node )->digest() : static_cast<Hash *>( node )->digest();
+    if ( (this->shared_cnt+1)*2 > (this->shared_mask+1) ) {
+        int          old_cnt = this->shared_mask+1;
+        SharedNode * old     = this->shared;
+        int          cnt     = (old_cnt == 0) ? 1024 : (old_cnt << 1);
+        this->shared = new SharedNode[cnt];
+        this->shared_mask = cnt-1;
+        for( int i = 0; i < cnt; i++ ) this->shared[i].node = nullptr;
+        for( int i = 0; i < old_cnt; i++ )
+        {
+            if ( old[i].node == nullptr ) continue;
+            int j = old[i].digest & this->shared_mask;
+            while( this->shared[j].node != nullptr ) j = (j+1) & this->shared_mask;
+            this->shared[j] = old[i];
+        }
+        delete[] old;
+    }
+
+    int i = digest & this->shared_mask;
+    for( ; this->shared[i].node != nullptr; i = (i+1) & this->shared_mask )
+    {
+        SharedNode& e = this->shared[i];
+        if ( e.digest != digest || e.is_list != is_list ) continue;
+        if ( is_list ? static_cast<List *>( e.node )->equal( *static_cast<List *>( node ) )
+                     : static_cast<Hash *>( e.node )->equal( *static_cast<Hash *>( node ) ) ) return e.node;
+    }
+    this->shared[i].digest = digest;
+    this->shared[i].node = node;
+    this->shared[i].is_list = is_list;
+    this->shared_cnt++;
+    return nullptr;
+}
+
+Hash * NodeIO::Impl::hash_share( Hash * hash, const nArena::Mark& mark )
+{
+    this->node_cnt++;
+    if ( !this->dedupe ) return hash;
+    Hash * prev = static_cast<Hash *>( this->shared_find( hash, false ) );
+    if ( prev == nullptr ) return hash;
+
+    this->shared_hit_cnt++;
+    if ( this->arena != nullptr ) {
+        this->arena->release( mark );
+    } else {
+        int hdl;
+        for( int id = hash->id_first( hdl ); !this->str_pool && id >= 0; id = hash->id_next( hdl ) )
+        {
+            if ( hash->kind( id ) == STR ) free( const_cast<char *>( hash->s( id ) ) );
+        }
+        delete hash;
+    }
+    return prev;
+}
+
+List * NodeIO::Impl::list_share( List * list, const nArena::Mark& mark )
+{
+    this->node_cnt++;
+    if ( !this->dedupe ) return list;
+    List * prev = static_cast<List *>( this->shared_find( list, true ) );
+    if ( prev == nullptr ) return list;
+
+    this->shared_hit_cnt++;
+    if ( this->arena != nullptr ) {
+        this->arena->release( mark );
+    } else {
+        for( int i = 0; !this->str_pool && i < list->length(); i++ )
+        {
+            if ( list->kind( i ) == STR ) free( const_cast<char *>( list->s( i ) ) );
+        }
+        delete list;
+    }
+    return prev;
+}
+
+//----------------------------------------------------------------
+// Character Runs
+//
+// The scanner spends most of its time finding where a run of one class of
+// characters ends: blanks, identifier chars, digits, the plain part of a
+// string literal, the rest of a comment.  These classify a whole chunk 
+// of input at once into a bitmask (AVX2: 32 bytes, SSE2: 16) and take the
+// first set bit, simdjson-style.  The default build targets plain x86-64,
+// so it uses SSE2; "make AVX2=1" builds the AVX2 versions.  Building with 
+// -DNODEIO_SCALAR, or for a target without SSE2, uses plain per-char 
+// loops instead.
+//
+// None of the classes includes NUL except the ones that stop at it, so 
+// every run ends at the buffer's terminating NUL.  Chunks may be loaded 
+// from up to SCAN_PAD bytes beyond it, so buffers are allocated with that 
+// much padding.
+//----------------------------------------------------------------
+enum
+{
+    CC_BLANK    = 1,    // ' ' '\t' '\r'
+    CC_WORD     = 2,    // identifier chars
+    CC_DIGIT    = 4,    // '0' .. '9'
+    CC_STR_END  = 8,    // '"' '\\' '\n' '\0'
+    CC_LINE_END = 16,   // '\n' '\0'
+    CC_STRUCT   = 32,   // '[' ']' '{' '}' ',' '"' '#' '\n' '\0'
+};
+
+static inline bool char_in( char c, int cls )
+{
+    switch( cls )
+    {
+        case CC_BLANK:      return c == ' ' || c == '\t' || c == '\r';
+        case CC_DIGIT:      return c >= '0' && c <= '9';
+        case CC_WORD:       return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        case CC_STR_END:    return c == '"' || c == '\\' || c == '\n' || c == '\0';
+        case CC_LINE_END:   return c == '\n' || c == '\0';
+        case CC_STRUCT:     return c == '[' || c == ']' || c == '{' || c == '}' || c == ',' || c == '"' || c == '#' || c == '\n' || c == '\0';
+        default:            dassert( 0 ); return false;
+    }
+}
+
+#if !defined( NODEIO_SCALAR ) && (defined( __AVX2__ ) || defined( __SSE2__ ))
+#include <immintrin.h>
+
+#if defined( __AVX2__ )
+typedef __m256i  chunk_t;
+const int        CHUNK_LEN = 32;
+static inline chunk_t  chunk_load( const char * p )         { return _mm256_loadu_si256( reinterpret_cast<const __m256i *>( p ) ); }
+static inline chunk_t  chunk_splat( char ch )               { return _mm256_set1_epi8( ch ); }
+static inline chunk_t  chunk_eq( chunk_t c, char ch )       { return _mm256_cmpeq_epi8( c, _mm256_set1_epi8( ch ) ); }
+static inline chunk_t  chunk_gt( chunk_t c, char ch )       { return _mm256_cmpgt_epi8( c, _mm256_set1_epi8( ch ) ); }
+static inline chunk_t  chunk_lt( chunk_t c, char ch )       { return _mm256_cmpgt_epi8( _mm256_set1_epi8( ch ), c ); }
+static inline chunk_t  chunk_or( chunk_t a, chunk_t b )     { return _mm256_or_si256( a, b ); }
+static inline chunk_t  chunk_and( chunk_t a, chunk_t b )    { return _mm256_and_si256( a, b ); }
+static inline uint32_t chunk_mask( chunk_t c )              { return _mm256_movemask_epi8( c ); }
+static const char *    scanner_name = "avx2";
+#else
+typedef __m128i  chunk_t;
+const int        CHUNK_LEN = 16;
+static inline chunk_t  chunk_load( const char * p )         { return _mm_loadu_si128( reinterpret_cast<const __m128i *>( p ) ); }
+static inline chunk_t  chunk_splat( char ch )               { return _mm_set1_epi8( ch ); }
+static inline chunk_t  chunk_eq( chunk_t c, char ch )       { return _mm_cmpeq_epi8( c, _mm_set1_epi8( ch ) ); }
+static inline chunk_t  chunk_gt( chunk_t c, char ch )       { return _mm_cmpgt_epi8( c, _mm_set1_epi8( ch ) ); }
+static inline chunk_t  chunk_lt( chunk_t c, char ch )       { return _mm_cmplt_epi8( c, _mm_set1_epi8( ch ) ); }
+static inline chunk_t  chunk_or( chunk_t a, chunk_t b )     { return _mm_or_si128( a, b ); }
+static inline chunk_t  chunk_and( chunk_t a, chunk_t b )    { return _mm_and_si128( a, b ); }
+static inline uint32_t chunk_mask( chunk_t c )              { return _mm_movemask_epi8( c ); }
+static const char *    scanner_name = "sse2";
+#endif
+
+static inline chunk_t chunk_range( chunk_t c, char lo, char hi )
+{
+    // signed compares, so bytes >= 0x80 are never in a range
+    return chunk_and( chunk_gt( c, lo-1 ), chunk_lt( c, hi+1 ) );
+}
+
+static inline uint32_t chunk_class( const char * p, int cls )
+{
+    //---------------------------------------
+    // Bit i is set if p[i] is in cls.  cls is always a constant, 
+    // so this folds down to the compares for one class.  Letters
+    // are matched by ORing in 0x20, which folds upper case onto lower.
+    //---------------------------------------
+    chunk_t c = chunk_load( p );
+    chunk_t m;
+    switch( cls )
+    {
+        case CC_BLANK:      m = chunk_or( chunk_or( chunk_eq( c, ' ' ), chunk_eq( c, '\t' ) ), chunk_eq( c, '\r' ) );  break;
+        case CC_DIGIT:      m = chunk_range( c, '0', '9' );                                                             break;
+        case CC_WORD:       m = chunk_or( chunk_or( chunk_range( c, '0', '9' ), chunk_range( chunk_or( c, chunk_splat( 0x20 ) ), 'a', 'z' ) ), chunk_eq( c, '_' ) ); break;
+        case CC_STR_END:    m = chunk_or( chunk_or( chunk_eq( c, '"' ), chunk_eq( c, '\\' ) ), chunk_or( chunk_eq( c, '\n' ), chunk_eq( c, '\0' ) ) ); break;
+        case CC_LINE_END:   m = chunk_or( chunk_eq( c, '\n' ), chunk_eq( c, '\0' ) );                                 break;
+        case CC_STRUCT:     
+        {
+            chunk_t l = chunk_or( c, chunk_splat( 0x20 ) );   // '[' ']' fold onto '{' '}'
+            m = chunk_or( chunk_or( chunk_eq( l, '{' ), chunk_eq( l, '}' ) ), chunk_or( chunk_eq( c, ',' ), chunk_eq( c, '"' ) ) );
+            m = chunk_or( m, chunk_or( chunk_eq( c, '#' ), chunk_or( chunk_eq( c, '\n' ), chunk_eq( c, '\0' ) ) ) );
+            break;
+        }
+        default:            dassert( 0 ); m = c;                                                                       break;
+    }
+    return chunk_mask( m );
+}
+
+static inline char * run_in( char * p, int cls )
+{
+    // first char at or after p that is not in cls
+    if ( !char_in( *p, cls ) ) return p;        // most runs are short
+    for( ;; p += CHUNK_LEN )
+    {
+        uint32_t m = ~chunk_class( p, cls );
+        m &= uint32_t( (uint64_t( 1 ) << CHUNK_LEN) - 1 );
+        if ( m != 0 ) return p + __builtin_ctz( m );
+    }
+}
+
+static inline char * run_out( char * p, int cls )
+{
+    // first char at or after p that is in cls
+    if ( char_in( *p, cls ) ) return p;
+    for( ;; p += CHUNK_LEN )
+    {
+        uint32_t m = chunk_class( p, cls );
+        if ( m != 0 ) return p + __builtin_ctz( m );
+    }
+}
+
+#else
+static inline char * run_in( char * p, int cls )
+{
+    while( char_in( *p, cls ) ) p++;
+    return p;
+}
+
+static inline char * run_out( char * p, int cls )
+{
+    while( !char_in( *p, cls ) ) p++;
+    return p;
+}
+
+static const char * scanner_name = "scalar";
+#endif
+
+const char * NodeIO::scanner( void )
+{
+    return scanner_name;
+}
+
+//----------------------------------------------------------------
+// Parallel parsing of the top-level list.
+//
+// The whole input is brought into memory (it already is when mapped) and
+// one sequential pass that looks only at brackets, commas, strings and 
+// comments picks top-level commas at about equal fractions of it.  Those
+// commas and the closing ']' are overwritten with NULs, so each piece 
+// looks like a whole file of comma-separated elements to a worker Impl 
+// of its own.  They are put back once the workers are done, so the text
+// can be parsed again after an elem_seek().  Workers parse onto their own scratch stacks and into their
+// own arenas, and the elements are spliced back together in order, so the 
+// List is the same one a serial parse builds.
+//
+// Each worker dedupes only within its piece.  The scanner reads a little
+// past a piece's NUL into the next piece, so pieces must not be written
+// while others are parsed, and strings are copied even if str_in_place 
+// is on.  Input too small to be worth splitting, or that doesn't split 
+// cleanly, is parsed serially, which also reports any syntax error.
+//----------------------------------------------------------------
+List * NodeIO::Impl::list_parse_parallel( void )
+{
+    this->all_read();
+    if ( !this->token_peek_eq( TOK_LSQUARE ) ) return this->list_parse();
+
+    int     cnt    = this->thread_cnt;
+    char ** starts = new char *[cnt+1];
+    int *   lines  = new int[cnt+1];
+    cnt = this->chunks_split( cnt, starts, lines );
+    if ( cnt == 0 ) {
+        delete[] starts;
+        delete[] lines;
+        return this->list_parse();
+    }
+    this->token = TOK_NONE;
+
+    Impl **        workers = new Impl *[cnt];
+    std::thread ** threads = new std::thread *[cnt];
+    char *         ends    = new char[cnt];                    // chars under the NULs
+    for( int k = 0; k < cnt; k++ )
+    {
+        Impl * w = new Impl();
+        w->buf_pos  = starts[k];
+        w->buf_end  = starts[k+1] - 1;
+        w->line_num = lines[k];
+        w->shaped   = this->shaped;
+        w->str_pool = this->str_pool;
+        w->dedupe   = this->dedupe;
+        w->arena    = (this->arena != nullptr) ? new nArena() : nullptr;
+        ends[k]     = *w->buf_end;
+        *w->buf_end = '\0';
+        workers[k] = w;
+    }
+    for( int k = 1; k < cnt; k++ )
+    {
+        threads[k] = new std::thread( &Impl::chunk_parse, workers[k] );
+    }
+    workers[0]->chunk_parse();
+    for( int k = 1; k < cnt; k++ )
+    {
+        threads[k]->join();
+        delete threads[k];
+    }
+    for( int k = 0; k < cnt; k++ ) *(starts[k+1] - 1) = ends[k];
+
+    int start = this->scratch_cnt;
+    for( int k = 0; k < cnt; k++ )
+    {
+        Impl * w = workers[k];
+        for( int i = 0; i < w->scratch_cnt; i++ ) *this->scratch_push() = w->scratch[i];
+        if ( w->arena != nullptr ) {
+            this->arena->adopt( *w->arena );
+            delete w->arena;
+        }
+        this->node_cnt += w->node_cnt;
+        this->shared_hit_cnt += w->shared_hit_cnt;
+        delete w;
+    }
+    int    len  = this->scratch_cnt - start;
+    List * list = (this->arena != nullptr) ? this->arena->list_new( &this->scratch[start], len ) : new List( &this->scratch[start], len );
+    this->scratch_cnt = start;
+    this->node_cnt++;
+
+    this->buf_pos  = starts[cnt];
+    this->line_num = lines[cnt];
+    delete[] threads;
+    delete[] workers;
+    delete[] ends;
+    delete[] starts;
+    delete[] lines;
+    return list;
+}
+
+int NodeIO::Impl::chunks_split( int cnt, char ** starts, int * lines )
+{
+    //---------------------------------------
+    // Piece k runs from starts[k] up to the top-level ',' or the final
+    // ']' at starts[k+1]-1.  lines[k] is the line number at starts[k].
+    // Returns the number of pieces, or 0 to parse serially.
+    //---------------------------------------
+    char * p   = this->buf_pos;
+    long   len = this->buf_end - p;
+    if ( len / cnt < CHUNK_MIN ) cnt = len / CHUNK_MIN;
+    if ( cnt < 2 ) return 0;
+
+    int    k      = 0;
+    int    depth  = 1;
+    int    line   = this->line_num;
+    char * target = p + len / cnt;
+    starts[0] = p;
+    lines[0]  = line;
+    for( ;; p++ )
+    {
+        p = run_out( p, CC_STRUCT );
+        switch( *p )
+        {
+            case '[':
+            case '{':
+                depth++;
+                break;
+
+            case ']':
+            case '}':
+                if ( --depth == 0 ) {
+                    if ( *p != ']' ) return 0;
+                    starts[++k] = p+1;
+                    lines[k]    = line;
+                    return k;
+                }
+                break;
+
+            case ',':
+                if ( depth == 1 && p >= target && k+1 < cnt ) {
+                    starts[++k] = p+1;
+                    lines[k]    = line;
+                    target      = starts[0] + len / cnt * (k+1);
+                }
+                break;
+
+            case '"':
+                for( ;; )
+                {
+                    p = run_out( p+1, CC_STR_END );
+                    if ( *p == '"' ) break;
+                    if ( *p != '\\' || p[1] == '\n' || p[1] == '\0' ) return 0;    // the scanner will complain
+                    p++;
+                }
+                break;
+
+            case '#':
+                p = run_out( p+1, CC_LINE_END ) - 1;
+                break;
+
+            case '\n':
+                line++;
+                break;
+
+            default:
+                return 0;                                                       // NUL before the closing ']'
+        }
+    }
+}
+
+void NodeIO::Impl::chunk_parse( void )
+{
+    for( ;; )
+    {
+        nVal v;
+        if ( this->val_parse( v ) ) *this->scratch_push() = v;
+        if ( this->token_peek_eq( TOK_COMMA ) ) {
+            this->token_expect( TOK_COMMA );
+        } else {
+            break;
+        }
+    }
+    this->token_expect( TOK_EOF );
 }
 
 //----------------------------------------------------------------
 // Parses one token.
+//
+// Tokens are scanned straight out of the block buffer.  The buffer is 
+// NUL-terminated at buf_end, so every scanning loop stops there; if that 
+// happens before the end of the file, the token may continue in the next 
+// block, so token_scan() gives up without consuming anything and is 
+// retried once block_read() has appended more input.
 //----------------------------------------------------------------
 int NodeIO::Impl::token_peek( void )
 {
     if ( this->token != TOK_NONE ) return this->token;
 
-    for( ;; )
+    while( (this->token = this->token_scan()) == TOK_NONE ) 
     {
-        while( this->line[this->line_pos] == '\0' )
-        {
-            if ( !getline() ) {
-                this->token = TOK_EOF;
-                return this->token;
-            }
-        }
+        this->block_read();
+    }
+    return this->token;
+}
 
-        char ch0 = this->line[this->line_pos];
+int NodeIO::Impl::token_scan( void )
+{
+    char * p   = this->buf_pos;
+    char * end = this->buf_end;
+    auto   more = [&]( const char * q ) { return q == end && !this->eof; };  // token may continue in the next block
+    bool   in_place = this->str_in_place && this->map != nullptr && this->arena != nullptr && !this->str_pool && this->index == nullptr;
+
+    for( ;; )
+    {
+        char ch0 = *p;
         switch( ch0 ) 
         {
+            case '\0':
+                if ( p == end ) {
+                    this->buf_pos = p;
+                    return this->eof ? TOK_EOF : TOK_NONE;
+                }
+                break;  // embedded NUL, reported below
+
             case '#':   
-                this->line[this->line_pos] = '\0';
-                break;
+            {
+                char * q = run_out( p+1, CC_LINE_END );
+                if ( more( q ) ) {
+                    this->buf_pos = p;          // rescan the whole comment
+                    return TOK_NONE;
+                }
+                p = q;
+                continue;
+            }
+
+            case '\n':
+                this->line_num++;
+                p++;
+                continue;
 
             case ' ':
             case '\t':
-                this->line_pos++;
-                break;
+            case '\r':
+                p = run_in( p+1, CC_BLANK );
+                continue;
 
             case '[':   
-                this->token = TOK_LSQUARE;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_LSQUARE;
 
             case ']':  
-                this->token = TOK_RSQUARE;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_RSQUARE;
 
             case '{':   
-                this->token = TOK_LCURLY;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_LCURLY;
 
             case '}':  
-                this->token = TOK_RCURLY;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_RCURLY;
 
             case '(':   
-                this->token = TOK_LPAREN;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_LPAREN;
 
             case ')':  
-                this->token = TOK_RPAREN;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_RPAREN;
 
             case ':': 
-                this->token = TOK_COLON;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_COLON;
 
             case ',':
-                this->token = TOK_COMMA;
-                this->line_pos++;
-                return this->token;
+                this->buf_pos = p+1;
+                return TOK_COMMA;
 
             case '"':
-                this->token = TOK_STR;
-                this->line_pos++;
-                for( int j = 0; ; j++ )
+            {
+                //---------------------------------------
+                // Copy plain runs whole, one char at a time only for
+                // escapes.  In place, the literal is unescaped over 
+                // itself, only writing (and so copying the page) once 
+                // chars have shifted.
+                //---------------------------------------
+                this->buf_pos = p;              // whitespace is consumed even if the token isn't complete
+                char * q = p+1;                 // next char to read
+                char * w = p+1;                 // in place: next char to write
+                int    j = 0;                   // otherwise: chars in token_str
+                for( ;; )
                 {
-                    char ch = this->line[this->line_pos++];
-                    if ( ch == '\0' ) {
-                        char msg[MSG_LEN];
-                        sprintf( msg, "string literal may not span a line: %s", this->line ); 
-                        error( msg );
-                    } 
+                    char * s   = run_out( q, CC_STR_END );
+                    int    len = s - q;
+                    if ( in_place ) {
+                        if ( w != q ) memmove( w, q, len );
+                        w += len;
+                    } else {
+                        this->token_str_fit( j + len );
+                        memcpy( this->token_str + j, q, len );
+                        j += len;
+                    }
+                    q = s;
 
+                    char ch = *q++;
                     if ( ch == '"' ) {
                         // done
-                        this->token_str[j] = '\0';
-                        return this->token;
+                        if ( in_place ) {
+                            *w = '\0';
+                            this->token_in_place = p+1;
+                        } else {
+                            this->token_str[j] = '\0';
+                            this->token_in_place = nullptr;
+                        }
+                        this->buf_pos = q;
+                        return TOK_STR;
                     }
-
                     if ( ch == '\\' ) {
                         // escape next character
-                        ch = this->line[this->line_pos];
-                        dassert( ch != '\0' );
+                        ch = *q++;
+                    }
+                    if ( (ch == '\0' && q-1 == end) || ch == '\n' ) {
+                        if ( more( q-1 ) ) return TOK_NONE;
+                        char msg[MSG_LEN];
+                        snprintf( msg, MSG_LEN, "string literal may not span a line (line %d)", this->line_num ); 
+                        error( msg );
+                    } 
+                    if ( in_place ) {
+                        *w++ = ch;
+                    } else {
+                        this->token_str_fit( j );
+                        this->token_str[j++] = ch;
                     }
-                    this->token_str[j] = ch;
                 }
-                break;
+            }
 
             default:
+                this->buf_pos = p;
                 if ( (ch0 >= 'a' && ch0 <= 'z') ||
                      (ch0 >= 'A' && ch0 <= 'Z') ||
                      ch0 == '_' ) {
-                    this->token = TOK_ID;
-                    int j;
-                    for( j = 0; ; j++, this->line_pos++ )
-                    {
-                        char ch = this->line[this->line_pos];
-                        if ( (ch >= '0' && ch <= '9') ||
-                             (ch >= 'a' && ch <= 'z') ||
-                             (ch >= 'A' && ch <= 'Z') ||
-                             ch == '_' ) {
-                            this->token_str[j] = ch;
-                        } else {
-                            break;
-                        }
-                    }
-                    this->token_str[j] = '\0';
-                    return this->token;
+                    char * q = run_in( p+1, CC_WORD );
+                    if ( more( q ) ) return TOK_NONE;
+                    int len = q - p;
+                    this->token_str_fit( len );
+                    memcpy( this->token_str, p, len );
+                    this->token_str[len] = '\0';
+                    this->buf_pos = q;
+                    return TOK_ID;
                 } else if ( ch0 == '+' || ch0 == '-' || (ch0 >= '0' && ch0 <= '9') ) {
-                    int sign = 0;
-                    if ( ch0 == '+' || ch0 == '-' ) {
-                        if ( ch0 == '-' ) sign = 1;        
-                        this->line_pos++;
+                    //---------------------------------------
+                    // Find the end first, so nothing is half-converted
+                    // if the number straddles blocks.
+                    //---------------------------------------
+                    char * digits = (ch0 == '+' || ch0 == '-') ? (p+1) : p;
+                    char * dot    = run_in( digits, CC_DIGIT );
+                    char * q      = (*dot == '.') ? run_in( dot+1, CC_DIGIT ) : dot;
+                    if ( more( q ) ) return TOK_NONE;
+                    if ( dot == digits ) {
+                        char msg[MSG_LEN];
+                        snprintf( msg, MSG_LEN, "number has no digits before the '.' (line %d)", this->line_num ); 
+                        error( msg );
                     }
 
-                    bool got_one = false;
+                    int token;
                     this->token_int = 0;
-                    for( ;; )
+                    for( char * d = digits; d != dot; d++ )
                     {
-                        char ch = this->line[this->line_pos];
-                        if ( ch >= '0' && ch <= '9' ) {
-                            this->token_int *= 10;
-                            this->token_int += (ch - '0');
-                            this->line_pos++;
-                            got_one = true;
-                        } else {
-                            dassert( got_one );
-                            break;
-                        }
+                        this->token_int *= 10;
+                        this->token_int += (*d - '0');
                     }
-                    if ( this->line[this->line_pos] != '.' ) {
-                        this->token = TOK_INT;
-                        if ( sign ) this->token_int = -this->token_int;
+                    if ( *dot != '.' ) {
+                        token = TOK_INT;
+                        if ( ch0 == '-' ) this->token_int = -this->token_int;
                     } else {
-                        this->line_pos++;
-                        this->token = TOK_FLT;
+                        token = TOK_FLT;
                         this->token_flt = this->token_int;
                         this->token_int = 0;
-                        int j;
-                        for( j = 0; ; j++ )
+                        for( char * d = dot+1; d != q; d++ )
                         {
-                            char ch = this->line[this->line_pos];
-                            if ( ch >= '0' && ch <= '9' ) {
-                                this->token_int *= 10;
-                                this->token_int += (ch - '0');
-                                this->line_pos++;
-                            } else {
-                                break;
-                            }
+                            this->token_int *= 10;
+                            this->token_int += (*d - '0');
                         }
-                        this->token_flt += nFlt( this->token_int ) / pow( 10.0, j );
-                        if ( sign ) this->token_flt = -this->token_flt;
+                        this->token_flt += nFlt( this->token_int ) / pow( 10.0, q - (dot+1) );
+                        if ( ch0 == '-' ) this->token_flt = -this->token_flt;
                     }
-                    return this->token;
-                } else {
-                    char msg[MSG_LEN];
-                    sprintf( msg, "unexpected char '%c' at index %d: %s", ch0, this->line_pos, this->line ); 
-                    error( msg );
-                    return TOK_NONE;
+                    this->buf_pos = q;
+                    return token;
                 }
                 break;
         }
+
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "unexpected char '%c' (line %d)", ch0, this->line_num ); 
+        error( msg );
+        return TOK_NONE;
+    }
+}
+
+//----------------------------------------------------------------
+// Scans without parsing, to time the scanner alone.
+//----------------------------------------------------------------
+long NodeIO::token_cnt( void )
+{
+    impl->text_only( "token_cnt()" );
+    long cnt = 0;
+    while( impl->token_peek() != TOK_EOF )
+    {
+        impl->token = TOK_NONE;
+        cnt++;
     }
+    return cnt;
+}
 
-    return TOK_NONE;  // should not get here
+//----------------------------------------------------------------
+// Grows token_str to hold at least len+1 chars.
+//----------------------------------------------------------------
+inline void NodeIO::Impl::token_str_fit( int len )
+{
+    if ( len < this->token_str_alloc ) return;
+    int old_alloc = this->token_str_alloc;
+    while( len >= this->token_str_alloc ) this->token_str_alloc <<= 1;
+    char * new_str = new char[this->token_str_alloc];
+    memcpy( new_str, this->token_str, old_alloc );
+    delete[] this->token_str;
+    this->token_str = new_str;
 }
 
 //----------------------------------------------------------------
@@ -395,24 +1400,577 @@ void NodeIO::Impl::token_expect( int tok )
         this->token = TOK_NONE;
     } else {
         char msg[MSG_LEN];
-        sprintf( msg, "expected token %d, got %d: %s", tok, this->token, this->line );
+        snprintf( msg, MSG_LEN, "expected token %d, got %d (line %d)", tok, this->token, this->line_num );
         error( msg );
     }
 }
+
 //----------------------------------------------------------------
-// Reads line and strips newline.
+// Maps an uncompressed file so it can be scanned in place, with no
+// zlib and no block copies.  The mapping is private, so string values 
+// can be NUL-terminated (and unescaped) in place when str_in_place is on;
+// only the pages written to get copied.  Text rewritten that way can't be
+// parsed again, so a file with an index, which elem_seek() can go back 
+// in, has its strings copied instead.  The file is mapped over a 
+// longer anonymous reservation, which guarantees the NUL after the last
+// byte, and the padding past it, that the scanner needs.
+//
+// Returns false, leaving gzopen() to report any problem, for compressed 
+// files, anything that isn't a regular file, or if mmap() fails.
 //----------------------------------------------------------------
-bool NodeIO::Impl::getline( void )
+static nCodec codec_sniff( int fd )
 {
-    this->line[0] = '\0';
-    this->line_pos = 0;
-    char * ptr = gzgets( this->file_hdl, this->line, LINE_LEN );
-    if ( ptr == nullptr ) return false;
+    unsigned char m[4];
+    ssize_t len = pread( fd, m, 4, 0 );
+    if ( len >= 2 && m[0] == 0x1f && m[1] == 0x8b ) return CODEC_GZIP;
+    if ( len >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd ) return CODEC_ZSTD;
+    if ( len >= 4 && m[0] == 0x04 && m[1] == 0x22 && m[2] == 0x4d && m[3] == 0x18 ) return CODEC_LZ4;
+    return CODEC_NONE;
+}
 
-    int i = strlen( this->line ) - 1;
-    if ( i >= 0 && this->line[i] == '\n' ) {
-        this->line[i] = '\0';
+bool NodeIO::Impl::file_map( const char * file_path )
+{
+    int fd = open( file_path, O_RDONLY );
+    if ( fd < 0 ) return false;
+
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size < 2 || codec_sniff( fd ) != CODEC_NONE ) {
+        close( fd );
+        return false;
+    }
+
+    size_t len  = st.st_size;
+    size_t page = sysconf( _SC_PAGESIZE );
+    size_t map_len = (len + 1+SCAN_PAD + page-1) & ~(page-1);
+    void * map = mmap( nullptr, map_len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+    if ( map != MAP_FAILED && mmap( map, len, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_FIXED, fd, 0 ) == MAP_FAILED ) {
+        munmap( map, map_len );
+        map = MAP_FAILED;
     }
-    dprintf( "line: %s\n", this->line );
+    close( fd );
+    if ( map == MAP_FAILED ) return false;
+    madvise( map, len, MADV_SEQUENTIAL );
+
+    this->map = static_cast<char *>( map );
+    this->map_len = map_len;
+    this->buf = this->map;
+    this->buf_len = len;
+    this->buf_pos = this->buf;
+    this->buf_end = this->buf + len;
+    this->eof = true;
     return true;
 }
+
+//----------------------------------------------------------------
+// Reads everything left in the file into buf, for list_parse_parallel().
+//----------------------------------------------------------------
+void NodeIO::Impl::all_read( void )
+{
+    while( !this->eof ) this->block_read();
+}
+
+//----------------------------------------------------------------
+// Reads the next block, keeping the unconsumed tail of the current one
+// (a partial token) in front of it.  The buffer doubles if that tail 
+// leaves less than half of it free, so a token can be any length.
+// Sets eof once the file has nothing more to give.
+//----------------------------------------------------------------
+void NodeIO::Impl::block_read( void )
+{
+    dassert( !this->eof );
+    int keep = this->buf_end - this->buf_pos;
+    if ( keep > (this->buf_len >> 1) ) {
+        this->buf_len <<= 1;
+        char * new_buf = new char[this->buf_len+1+SCAN_PAD];
+        memcpy( new_buf, this->buf_pos, keep );
+        delete[] this->buf;
+        this->buf = new_buf;
+    } else {
+        memmove( this->buf, this->buf_pos, keep );
+    }
+
+    int len;
+    if ( this->index_read ) {
+        len = this->index->read( this->buf + keep, this->buf_len - keep );
+    } else if ( this->gunzip != nullptr ) {
+        len = this->gunzip->read( this->buf + keep, this->buf_len - keep );
+    } else if ( this->file_hdl == nullptr ) {
+        len = this->codec_read( this->buf + keep, this->buf_len - keep );
+    } else {
+        len = gzread( this->file_hdl, this->buf + keep, this->buf_len - keep );
+        if ( len < 0 ) {
+            int errnum;
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "could not read file: %s", gzerror( this->file_hdl, &errnum ) );
+            error( msg );
+        }
+    }
+    if ( len == 0 ) this->eof = true;
+    this->buf_pos = this->buf;
+    this->buf_end = this->buf + keep + len;
+    *this->buf_end = '\0';
+    dprintf( "block: %d bytes\n", keep + len );
+}
+
+//----------------------------------------------------------------
+// zstd and lz4 input.
+//
+// Files are recognized by their magic bytes, whatever they are called.
+// gzip support comes with zlib; zstd and lz4 need their libraries and 
+// a build with -DNODEIO_ZSTD or -DNODEIO_LZ4, for example:
+//
+//     make EXTRA_CFLAGS="-DNODEIO_ZSTD -DNODEIO_LZ4" EXTRA_LFLAGS="-lzstd -llz4"
+//
+// Both decode several times faster than zlib inflates, which matters 
+// once the scanner is no longer the bottleneck.  A file may hold any 
+// number of frames back to back; zstd skippable frames, such as the seek
+// table of the seekable format that NodeIOWriter writes, are skipped.
+//----------------------------------------------------------------
+nCodec NodeIO::codec( const char * file_path )
+{
+    int fd = open( file_path, O_RDONLY );
+    if ( fd < 0 ) return CODEC_NONE;
+    nCodec codec = codec_sniff( fd );
+    close( fd );
+    return codec;
+}
+
+bool NodeIO::codec_built( nCodec codec )
+{
+    switch( codec )
+    {
+        case CODEC_NONE:    
+        case CODEC_GZIP:    return true;
+#ifdef NODEIO_ZSTD
+        case CODEC_ZSTD:    return true;
+#endif
+#ifdef NODEIO_LZ4
+        case CODEC_LZ4:     return true;
+#endif
+        default:            return false;
+    }
+}
+
+void NodeIO::Impl::codec_open( const char * file_path )
+{
+    char msg[MSG_LEN];
+    if ( !NodeIO::codec_built( this->codec ) ) {
+        snprintf( msg, MSG_LEN, "%s is %s-compressed; this build can't read it (see NodeIO.cpp)", 
+                  file_path, (this->codec == CODEC_ZSTD) ? "zstd" : "lz4" );
+        error( msg );
+    }
+    this->fd = open( file_path, O_RDONLY );
+    if ( this->fd < 0 ) {
+        snprintf( msg, MSG_LEN, "could not open file %s for reading, errno=%d", file_path, errno );
+        error( msg );
+    }
+    this->zbuf = new char[ZBUF_LEN];
+    this->zbuf_pos = 0;
+    this->zbuf_end = 0;
+    this->zframe_open = false;
+#ifdef NODEIO_ZSTD
+    this->zstd = nullptr;
+    if ( this->codec == CODEC_ZSTD && (this->zstd = ZSTD_createDCtx()) == nullptr ) error( "could not start zstd" );
+#endif
+#ifdef NODEIO_LZ4
+    this->lz4 = nullptr;
+    if ( this->codec == CODEC_LZ4 && LZ4F_isError( LZ4F_createDecompressionContext( &this->lz4, LZ4F_VERSION ) ) ) error( "could not start lz4" );
+#endif
+}
+
+void NodeIO::Impl::codec_close( void )
+{
+#ifdef NODEIO_ZSTD
+    if ( this->zstd != nullptr ) ZSTD_freeDCtx( this->zstd );
+#endif
+#ifdef NODEIO_LZ4
+    if ( this->lz4 != nullptr ) LZ4F_freeDecompressionContext( this->lz4 );
+#endif
+    delete[] this->zbuf;
+    close( this->fd );
+}
+
+int NodeIO::Impl::codec_read( char * to, int len )
+{
+    //---------------------------------------
+    // Decoders return 0 once a frame is done and all of it is out.
+    // Until then, they may have output left even without more input.
+    //---------------------------------------
+    char msg[MSG_LEN];
+    int  got = 0;
+    while( got < len )
+    {
+        if ( this->zbuf_pos == this->zbuf_end ) {
+            ssize_t zlen = ::read( this->fd, this->zbuf, ZBUF_LEN );
+            if ( zlen < 0 && errno == EINTR ) continue;
+            if ( zlen < 0 ) {
+                snprintf( msg, MSG_LEN, "could not read file, errno=%d", errno );
+                error( msg );
+            }
+            this->zbuf_pos = 0;
+            this->zbuf_end = zlen;
+            if ( zlen == 0 && !this->zframe_open ) break;
+        }
+
+        size_t in_len  = this->zbuf_end - this->zbuf_pos;
+        size_t out_len = len - got;
+        size_t hint    = 0;
+        const char * err = nullptr;
+        switch( this->codec )
+        {
+#ifdef NODEIO_ZSTD
+            case CODEC_ZSTD:
+            {
+                ZSTD_inBuffer  in  = { this->zbuf + this->zbuf_pos, in_len, 0 };
+                ZSTD_outBuffer out = { to + got, out_len, 0 };
+                hint = ZSTD_decompressStream( this->zstd, &out, &in );
+                if ( ZSTD_isError( hint ) ) err = ZSTD_getErrorName( hint );
+                in_len  = in.pos;
+                out_len = out.pos;
+                break;
+            }
+#endif
+#ifdef NODEIO_LZ4
+            case CODEC_LZ4:
+                hint = LZ4F_decompress( this->lz4, to + got, &out_len, this->zbuf + this->zbuf_pos, &in_len, nullptr );
+                if ( LZ4F_isError( hint ) ) err = LZ4F_getErrorName( hint );
+                break;
+#endif
+            default:
+                err = "unknown codec";
+                break;
+        }
+        if ( err == nullptr && in_len == 0 && out_len == 0 && this->zbuf_pos == this->zbuf_end ) err = "unexpected end of file";
+        if ( err != nullptr ) {
+            snprintf( msg, MSG_LEN, "could not read file: %s", err );
+            error( msg );
+        }
+        this->zbuf_pos += in_len;
+        this->zframe_open = hint != 0;
+        got += out_len;
+    }
+    return got;
+}
+
+//----------------------------------------------------------------
+// Parallel gunzip.
+//
+// gzip files written as independent members, as NodeIOWriter and 
+// "pigz --independent" write them, can be inflated a member at a time
+// on separate threads.  Where members start isn't recorded anywhere, so
+// the mapped file is searched for candidate headers (1f 8b 08 with no 
+// reserved flags) ahead of the member being read.  Worker threads inflate
+// candidates speculatively, each into a buffer of its own, and read() 
+// hands those out in file order.  
+//
+// Compressed data can contain the same three bytes, but a false 
+// candidate usually fails to inflate within a few bytes and never gets 
+// past the CRC check.  Either way, read() only uses a member that starts
+// exactly where the previous one ended, so what it returns is always 
+// what gzread() would.  When the next member isn't ready in time, is 
+// bigger than MEMBER_MAX, or is corrupt, read() inflates it itself, 
+// which also reports any error.  Bytes after the last member that aren't
+// another gzip header are ignored, as gzread() does.
+//
+// NodeIO switches to this when threads_set() asks for more than one 
+// thread before anything has been read from a gzip file.  A file that is
+// a single member gains nothing, but loses nothing beyond the search.
+//----------------------------------------------------------------
+const size_t INFLATE_IN_MAX = 1 << 30;      // z_stream lengths are 32 bits
+const size_t INFLATE_OUT    = 256 << 10;    // output per inflate() call, so cancels are seen promptly
+
+Gunzip * Gunzip::open( int fd, int thread_cnt )
+{
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) return nullptr;
+    void * addr = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( addr == MAP_FAILED ) return nullptr;
+    madvise( addr, st.st_size, MADV_SEQUENTIAL );
+
+    Gunzip * g = new Gunzip();
+    g->map = reinterpret_cast<const uint8_t *>( addr );
+    g->map_len = st.st_size;
+    g->pos = 0;
+    g->scan_off = 0;
+    g->done = false;
+    g->cur = nullptr;
+    g->cur_pos = 0;
+    g->streaming = false;
+    g->strm.zalloc = Z_NULL;
+    g->strm.zfree = Z_NULL;
+    g->strm.opaque = Z_NULL;
+    g->strm.next_in = Z_NULL;
+    g->strm.avail_in = 0;
+    if ( inflateInit2( &g->strm, 31 ) != Z_OK ) error( "could not start inflate" );
+    g->ahead = 2 * thread_cnt;
+    g->stopping = false;
+    g->worker_cnt = thread_cnt - 1;
+    g->workers = new std::thread *[g->worker_cnt];
+    for( int k = 0; k < g->worker_cnt; k++ )
+    {
+        g->workers[k] = new std::thread( &Gunzip::worker, g );
+    }
+    return g;
+}
+
+Gunzip::~Gunzip()
+{
+    {
+        std::unique_lock<std::mutex> lock( this->mutex );
+        for( Member * m : this->members )
+        {
+            if ( m->state == RUNNING ) {
+                m->cancel = true;
+            } else {
+                delete[] m->out;
+                delete m;
+            }
+        }
+        this->members.clear();
+        this->stopping = true;
+        this->cond.notify_all();
+    }
+    for( int k = 0; k < this->worker_cnt; k++ )
+    {
+        this->workers[k]->join();
+        delete this->workers[k];
+    }
+    delete[] this->workers;
+    if ( this->cur != nullptr ) {
+        delete[] this->cur->out;
+        delete this->cur;
+    }
+    inflateEnd( &this->strm );
+    munmap( const_cast<uint8_t *>( this->map ), this->map_len );
+}
+
+int Gunzip::read( char * to, int len )
+{
+    int got = 0;
+    while( got < len && !this->done )
+    {
+        if ( this->cur != nullptr ) {
+            size_t n = this->cur->out_len - this->cur_pos;
+            if ( n > size_t( len - got ) ) n = len - got;
+            memcpy( to + got, this->cur->out + this->cur_pos, n );
+            this->cur_pos += n;
+            got += n;
+            if ( this->cur_pos == this->cur->out_len ) {
+                size_t end = this->cur->end;
+                delete[] this->cur->out;
+                delete this->cur;
+                this->cur = nullptr;
+                this->member_next( end );
+            }
+        } else if ( this->streaming ) {
+            got += this->stream( to + got, len - got );
+        } else {
+            this->member_start();
+        }
+    }
+    return got;
+}
+
+void Gunzip::member_next( size_t end )
+{
+    //---------------------------------------
+    // Candidates before end were inside the member just read.
+    //---------------------------------------
+    std::unique_lock<std::mutex> lock( this->mutex );
+    this->pos = end;
+    while( !this->members.empty() && this->members.front()->start < end )
+    {
+        Member * m = this->members.front();
+        this->members.pop_front();
+        if ( m->state == RUNNING ) {
+            m->cancel = true;
+        } else {
+            delete[] m->out;
+            delete m;
+        }
+    }
+    if ( this->scan_off < end ) this->scan_off = end;
+    this->members_top_up();
+}
+
+void Gunzip::member_start( void )
+{
+    //---------------------------------------
+    // A finished worker's text is used as is.  Otherwise the member is 
+    // inflated here; one still running is waited for instead, since it 
+    // would usually finish first.
+    //---------------------------------------
+    if ( this->pos + 2 > this->map_len || this->map[this->pos] != 0x1f || this->map[this->pos+1] != 0x8b ) {
+        this->done = true;
+        return;
+    }
+    std::unique_lock<std::mutex> lock( this->mutex );
+    this->members_top_up();
+    Member * m = nullptr;
+    if ( !this->members.empty() && this->members.front()->start == this->pos ) {
+        m = this->members.front();
+        this->cond.wait( lock, [m]{ return m->state != RUNNING; } );
+        this->members.pop_front();
+    }
+    if ( m != nullptr && m->state == DONE ) {
+        this->cur = m;
+        this->cur_pos = 0;
+    } else {
+        if ( m != nullptr ) {
+            delete[] m->out;
+            delete m;
+        }
+        if ( inflateReset( &this->strm ) != Z_OK ) error( "could not restart inflate" );
+        this->strm.avail_in = 0;
+        this->in_off = this->pos;
+        this->streaming = true;
+    }
+}
+
+void Gunzip::members_top_up( void )
+{
+    size_t last = (this->map_len > 18) ? this->map_len - 18 : 0;    // smallest member is 18 bytes
+    bool   added = false;
+    while( int( this->members.size() ) < this->ahead && this->scan_off < last )
+    {
+        const uint8_t * p = reinterpret_cast<const uint8_t *>( memchr( this->map + this->scan_off, 0x1f, last - this->scan_off ) );
+        if ( p == nullptr ) {
+            this->scan_off = last;
+            break;
+        }
+        this->scan_off = p - this->map + 1;
+        if ( p[1] != 0x8b || p[2] != 8 || (p[3] & 0xe0) != 0 ) continue;
+
+        Member * m = new Member();
+        m->start = p - this->map;
+        m->end = 0;
+        m->out = nullptr;
+        m->out_len = 0;
+        m->state = PENDING;
+        m->cancel = false;
+        this->members.push_back( m );
+        added = true;
+    }
+    if ( added ) this->cond.notify_all();
+}
+
+int Gunzip::stream( char * to, int len )
+{
+    size_t in_len = this->strm.avail_in;
+    if ( in_len == 0 ) {
+        in_len = this->map_len - this->in_off;
+        if ( in_len > INFLATE_IN_MAX ) in_len = INFLATE_IN_MAX;
+        this->strm.next_in = const_cast<Bytef *>( this->map + this->in_off );
+        this->strm.avail_in = in_len;
+    }
+    this->strm.next_out = reinterpret_cast<Bytef *>( to );
+    this->strm.avail_out = len;
+    int status = inflate( &this->strm, Z_NO_FLUSH );
+    this->in_off += in_len - this->strm.avail_in;
+    int got = len - this->strm.avail_out;
+    if ( status == Z_STREAM_END ) {
+        this->streaming = false;
+        this->strm.avail_in = 0;
+        this->member_next( this->in_off );
+    } else if ( status == Z_BUF_ERROR && this->in_off == this->map_len ) {
+        error( "could not read file: unexpected end of file" );
+    } else if ( status != Z_OK && status != Z_BUF_ERROR ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not read file: %s", (this->strm.msg != nullptr) ? this->strm.msg : "inflate() failed" );
+        error( msg );
+    }
+    return got;
+}
+
+void Gunzip::worker( void )
+{
+    std::unique_lock<std::mutex> lock( this->mutex );
+    for( ;; ) 
+    {
+        Member * m = nullptr;
+        for( Member * c : this->members )
+        {
+            if ( c->state == PENDING ) {
+                m = c;
+                break;
+            }
+        }
+        if ( m == nullptr ) {
+            if ( this->stopping ) return;
+            this->cond.wait( lock );
+            continue;
+        }
+        m->state = RUNNING;
+        lock.unlock();
+        int state = member_inflate( this->map + m->start, this->map_len - m->start, m );
+        lock.lock();
+        if ( m->cancel ) {
+            delete[] m->out;
+            delete m;
+        } else {
+            m->state = state;
+            this->cond.notify_all();
+        }
+    }
+}
+
+int Gunzip::member_inflate( const uint8_t * in, size_t in_len, Member * m )
+{
+    z_stream strm;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    if ( inflateInit2( &strm, 31 ) != Z_OK ) return FAILED;
+
+    size_t in_off    = 0;
+    size_t out_alloc = 1 << 20;
+    m->out = new char[out_alloc];
+    m->out_len = 0;
+    int state = RUNNING;
+    while( state == RUNNING )
+    {
+        if ( m->cancel ) {
+            state = FAILED;
+            break;
+        }
+        if ( m->out_len == out_alloc ) {
+            if ( out_alloc == MEMBER_MAX ) {
+                state = TOO_BIG;
+                break;
+            }
+            out_alloc = (2*out_alloc < MEMBER_MAX) ? 2*out_alloc : MEMBER_MAX;
+            char * out = new char[out_alloc];
+            memcpy( out, m->out, m->out_len );
+            delete[] m->out;
+            m->out = out;
+        }
+        if ( strm.avail_in == 0 ) {
+            size_t n = in_len - in_off;
+            strm.next_in = const_cast<Bytef *>( in + in_off );
+            strm.avail_in = (n < INFLATE_IN_MAX) ? n : INFLATE_IN_MAX;
+        }
+        size_t out_len = out_alloc - m->out_len;
+        if ( out_len > INFLATE_OUT ) out_len = INFLATE_OUT;
+        size_t avail_in = strm.avail_in;
+        strm.next_out = reinterpret_cast<Bytef *>( m->out + m->out_len );
+        strm.avail_out = out_len;
+        int status = inflate( &strm, Z_NO_FLUSH );
+        in_off += avail_in - strm.avail_in;
+        m->out_len += out_len - strm.avail_out;
+        if ( status == Z_STREAM_END ) {
+            m->end = m->start + in_off;
+            state = DONE;
+        } else if ( (status != Z_OK && status != Z_BUF_ERROR) || (status == Z_BUF_ERROR && in_off == in_len) ) {
+            state = FAILED;
+        }
+    }
+    inflateEnd( &strm );
+    if ( state != DONE ) {
+        delete[] m->out;
+        m->out = nullptr;
+        m->out_len = 0;
+    }
+    return state;
+}
@@ -0,0 +1,670 @@
+// Copyright (c) 2017-2018 Robert A. Alfieri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Misc.h"
+#include "Node.h"
+#include "zlib.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "math.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#ifdef NODEIO_ZSTD
+#include <zstd.h>
+#endif
+#ifdef NODEIO_LZ4
+#include <lz4frame.h>
+#endif
+
+#undef dprintf
+#define dprintf if ( 0 ) printf
+
+//--------------------------------------------
+// Internal Implementation Structure
+//
+// Text collects in a 1MB buffer that goes to write() whole, or through
+// a gzip, zstd or lz4 encoder, so the output is never held in memory, 
+// however long a list is.
+//
+// Compressed output is cut into independent frames of ZFRAME_LEN chars
+// of text: gzip members, or zstd or lz4 frames (see NodeIO.cpp for 
+// building those in).  nIndex can restart at any of them, and NodeIO 
+// can gunzip members on several threads.  zstd files also end with the 
+// seek table of zstd's seekable format, a skippable frame that lists each
+// frame's compressed and text lengths, for zstd's own seekable tools; 
+// readers that don't know it skip it.  zstd can compress each frame on several threads.
+//
+// level is each codec's own: gzip 1..9, zstd 1..19 (or negative, for 
+// faster), lz4 1..12 (3 and up being lz4hc).  0 always means plain text.
+//
+// The top-level list or hash gets one element per line, the way viz
+// files are laid out; anything nested is written on the same line.
+//--------------------------------------------
+const int WBUF_LEN   = 1 << 20;
+const int MSG_LEN    = 256;
+const int ZFRAME_LEN = 4 << 20;                 // text per gzip member or zstd or lz4 frame
+const int GZBUF_LEN  = 1 << 17;                 // deflate output written at a time
+
+const uint32_t ZSTD_SKIP_MAGIC     = 0x184D2A5E;    // skippable frame
+const uint32_t ZSTD_SEEKABLE_MAGIC = 0x8F92EAB1;    // ends the seek table
+
+class NodeIOWriter::Impl
+{
+public:
+    int                 fd;                                                             // output file
+    nCodec              codec;                                                          // CODEC_NONE, CODEC_GZIP, CODEC_ZSTD or CODEC_LZ4
+    int                 level;                                                          // compression level
+    int                 thread_cnt;                                                     // zstd compresses on this many threads
+    char *              zbuf;                                                           // compressed output not yet written
+    size_t              zbuf_len;                                                       // allocated length
+    z_stream            gz;                                                             // when gzipping
+    bool                frame_open;                                                     // a member or frame has begun
+    int                 frame_len;                                                      // text in it so far
+    uint32_t            frame_zlen;                                                     // compressed bytes of it so far
+    int                 frame_cnt;                                                      // frames ended
+    uint32_t *          seeks;                                                          // zstd seek table: compressed, text length per frame
+    int                 seek_cnt;                                                       // frames in it
+    int                 seek_alloc;                                                     // frames allocated
+#ifdef NODEIO_ZSTD
+    ZSTD_CCtx *         zstd;
+#endif
+#ifdef NODEIO_LZ4
+    LZ4F_cctx *         lz4;
+    LZ4F_preferences_t  lz4_prefs;
+#endif
+    char *              buf;                                                            // text not yet written
+    int                 buf_pos;                                                        // chars in buf
+    long                flushed_len;                                                    // chars written before those
+    int                 depth;                                                          // lists and hashes open
+    bool *              firsts;                                                         // per depth: no element written yet
+    int                 firsts_alloc;                                                   // entries allocated
+    bool                after_key;                                                      // a property name is waiting for its value
+    char *              key_ok;                                                         // per id: 0 not checked, 1 identifier, 2 not
+    int                 key_ok_alloc;                                                   // entries allocated
+
+    void                put( const char * s, int len );                                 // append to buf
+    void                put( char c );
+    void                flush( void );                                                  // write buf out
+    void                write_all( const char * p, size_t len );                        // write() all of it
+    void                frame_put( const char * p, int len );                           // encode into the current frame
+    void                frame_end( void );                                              // finish the current frame
+    void                seeks_write( void );                                            // the zstd seek table
+    void                sep( void );                                                    // whatever goes before the next value or name
+    void                open( char c );                                                 // '[' or '{'
+    void                close( char c );                                                // ']' or '}'
+    void                key( int id );
+    void                i( nInt v );
+    void                f( nFlt v );
+    void                s( nStr v );
+    void                val( const nVal& v );
+    void                hash( Hash * hash );
+    void                list( List * list );
+};
+
+inline void NodeIOWriter::Impl::put( const char * s, int len )
+{
+    while( len > (WBUF_LEN - this->buf_pos) )
+    {
+        int n = WBUF_LEN - this->buf_pos;
+        memcpy( this->buf + this->buf_pos, s, n );
+        this->buf_pos += n;
+        this->flush();
+        s += n;
+        len -= n;
+    }
+    memcpy( this->buf + this->buf_pos, s, len );
+    this->buf_pos += len;
+}
+
+inline void NodeIOWriter::Impl::put( char c )
+{
+    if ( this->buf_pos == WBUF_LEN ) this->flush();
+    this->buf[this->buf_pos++] = c;
+}
+
+void NodeIOWriter::Impl::flush( void )
+{
+    if ( this->codec == CODEC_NONE ) {
+        this->write_all( this->buf, this->buf_pos );
+    } else {
+        for( int done = 0; done < this->buf_pos; )
+        {
+            int len = ZFRAME_LEN - this->frame_len;
+            if ( len > this->buf_pos - done ) len = this->buf_pos - done;
+            this->frame_put( this->buf + done, len );
+            if ( this->frame_len == ZFRAME_LEN ) this->frame_end();
+            done += len;
+        }
+    }
+    this->flushed_len += this->buf_pos;
+    this->buf_pos = 0;
+}
+
+void NodeIOWriter::Impl::write_all( const char * p, size_t len )
+{
+    for( size_t done = 0; done < len; )
+    {
+        ssize_t n = ::write( this->fd, p + done, len - done );
+        if ( n < 0 && errno == EINTR ) continue;
+        if ( n <= 0 ) {
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "could not write file, errno=%d", errno );
+            error( msg );
+        }
+        done += n;
+    }
+    if ( this->codec == CODEC_ZSTD ) this->frame_zlen += len;
+}
+
+//----------------------------------------------------------------
+// Frames
+//----------------------------------------------------------------
+void NodeIOWriter::Impl::frame_put( const char * p, int len )
+{
+    const char * err = nullptr;
+    switch( this->codec )
+    {
+        case CODEC_GZIP:
+            if ( !this->frame_open && deflateReset( &this->gz ) != Z_OK ) err = "deflateReset() failed";
+            this->gz.next_in  = reinterpret_cast<Bytef *>( const_cast<char *>( p ) );
+            this->gz.avail_in = len;
+            while( this->gz.avail_in != 0 && err == nullptr )
+            {
+                this->gz.next_out  = reinterpret_cast<Bytef *>( this->zbuf );
+                this->gz.avail_out = this->zbuf_len;
+                if ( deflate( &this->gz, Z_NO_FLUSH ) == Z_STREAM_ERROR ) err = "deflate() failed";
+                this->write_all( this->zbuf, this->zbuf_len - this->gz.avail_out );
+            }
+            break;
+
+#ifdef NODEIO_ZSTD
+        case CODEC_ZSTD:
+        {
+            //---------------------------------------
+            // The thread count may only change between frames.
+            // Libraries built without threads refuse it; they still work.
+            //---------------------------------------
+            if ( !this->frame_open ) ZSTD_CCtx_setParameter( this->zstd, ZSTD_c_nbWorkers, (this->thread_cnt > 1) ? this->thread_cnt : 0 );
+            ZSTD_inBuffer in = { p, size_t( len ), 0 };
+            while( in.pos < in.size && err == nullptr )
+            {
+                ZSTD_outBuffer out = { this->zbuf, this->zbuf_len, 0 };
+                size_t r = ZSTD_compressStream2( this->zstd, &out, &in, ZSTD_e_continue );
+                if ( ZSTD_isError( r ) ) err = ZSTD_getErrorName( r );
+                this->write_all( this->zbuf, out.pos );
+            }
+            break;
+        }
+#endif
+#ifdef NODEIO_LZ4
+        case CODEC_LZ4:
+        {
+            if ( !this->frame_open ) {
+                size_t r = LZ4F_compressBegin( this->lz4, this->zbuf, this->zbuf_len, &this->lz4_prefs );
+                if ( LZ4F_isError( r ) ) err = LZ4F_getErrorName( r );
+                if ( err == nullptr ) this->write_all( this->zbuf, r );
+            }
+            if ( err == nullptr && len != 0 ) {
+                size_t r = LZ4F_compressUpdate( this->lz4, this->zbuf, this->zbuf_len, p, len, nullptr );
+                if ( LZ4F_isError( r ) ) err = LZ4F_getErrorName( r );
+                if ( err == nullptr ) this->write_all( this->zbuf, r );
+            }
+            break;
+        }
+#endif
+        default:
+            err = "unknown codec";
+            break;
+    }
+    if ( err != nullptr ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not compress: %s", err );
+        error( msg );
+    }
+    this->frame_open = true;
+    this->frame_len += len;
+}
+
+void NodeIOWriter::Impl::frame_end( void )
+{
+    if ( !this->frame_open ) this->frame_put( "", 0 );
+    const char * err = nullptr;
+    switch( this->codec )
+    {
+        case CODEC_GZIP:
+            for( int status = Z_OK; status != Z_STREAM_END && err == nullptr; )
+            {
+                this->gz.next_out  = reinterpret_cast<Bytef *>( this->zbuf );
+                this->gz.avail_out = this->zbuf_len;
+                status = deflate( &this->gz, Z_FINISH );
+                if ( status == Z_STREAM_ERROR ) err = "deflate() failed";
+                this->write_all( this->zbuf, this->zbuf_len - this->gz.avail_out );
+            }
+            break;
+
+#ifdef NODEIO_ZSTD
+        case CODEC_ZSTD:
+        {
+            ZSTD_inBuffer in = { "", 0, 0 };
+            for( size_t r = 1; r != 0 && err == nullptr; )
+            {
+                ZSTD_outBuffer out = { this->zbuf, this->zbuf_len, 0 };
+                r = ZSTD_compressStream2( this->zstd, &out, &in, ZSTD_e_end );
+                if ( ZSTD_isError( r ) ) err = ZSTD_getErrorName( r );
+                this->write_all( this->zbuf, out.pos );
+            }
+            if ( this->seek_cnt == this->seek_alloc ) {
+                uint32_t * new_seeks = new uint32_t[4 * this->seek_alloc];
+                memcpy( new_seeks, this->seeks, 2 * this->seek_cnt * sizeof( uint32_t ) );
+                delete[] this->seeks;
+                this->seeks = new_seeks;
+                this->seek_alloc *= 2;
+            }
+            this->seeks[2*this->seek_cnt+0] = this->frame_zlen;
+            this->seeks[2*this->seek_cnt+1] = this->frame_len;
+            this->seek_cnt++;
+            break;
+        }
+#endif
+#ifdef NODEIO_LZ4
+        case CODEC_LZ4:
+        {
+            size_t r = LZ4F_compressEnd( this->lz4, this->zbuf, this->zbuf_len, nullptr );
+            if ( LZ4F_isError( r ) ) err = LZ4F_getErrorName( r );
+            if ( err == nullptr ) this->write_all( this->zbuf, r );
+            break;
+        }
+#endif
+        default:
+            err = "unknown codec";
+            break;
+    }
+    if ( err != nullptr ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not compress: %s", err );
+        error( msg );
+    }
+    this->frame_open = false;
+    this->frame_len = 0;
+    this->frame_zlen = 0;
+    this->frame_cnt++;
+}
+
+void NodeIOWriter::Impl::seeks_write( void )
+{
+    //---------------------------------------
+    // Little-endian: skippable frame header, an entry per frame, 
+    // then the frame count, a descriptor (no checksums) and the magic.
+    //---------------------------------------
+    int             len   = 8 + 8*this->seek_cnt + 9;
+    unsigned char * table = new unsigned char[len];
+    unsigned char * p     = table;
+    auto put32 = [&p]( uint32_t v ) { for( int i = 0; i < 4; i++ ) *p++ = v >> (8*i); };
+    put32( ZSTD_SKIP_MAGIC );
+    put32( len - 8 );
+    for( int k = 0; k < 2*this->seek_cnt; k++ ) put32( this->seeks[k] );
+    put32( this->seek_cnt );
+    *p++ = 0;
+    put32( ZSTD_SEEKABLE_MAGIC );
+    this->write_all( reinterpret_cast<char *>( table ), len );
+    delete[] table;
+}
+
+//----------------------------------------------------------------
+// Initialization
+//----------------------------------------------------------------
+NodeIOWriter::NodeIOWriter( const char * file_path, int level, nCodec codec )
+{
+    impl = new NodeIOWriter::Impl();
+
+    if ( level == 0 ) codec = CODEC_NONE;
+    if ( !NodeIO::codec_built( codec ) ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "this build can't write %s files (see NodeIO.cpp)", (codec == CODEC_ZSTD) ? "zstd" : "lz4" );
+        error( msg );
+    }
+    impl->codec = codec;
+    impl->level = level;
+    impl->thread_cnt = 1;
+    impl->zbuf = nullptr;
+    impl->zbuf_len = 0;
+    impl->frame_open = false;
+    impl->frame_len = 0;
+    impl->frame_zlen = 0;
+    impl->frame_cnt = 0;
+    impl->seeks = nullptr;
+    impl->seek_cnt = 0;
+    impl->seek_alloc = 0;
+    impl->fd = open( file_path, O_WRONLY|O_CREAT|O_TRUNC, 0666 );
+    if ( impl->fd < 0 ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not open file %s for writing, errno=%d", file_path, errno );
+        error( msg );
+    }
+    impl->buf = new char[WBUF_LEN];
+    impl->buf_pos = 0;
+    impl->flushed_len = 0;
+    impl->depth = 0;
+    impl->firsts_alloc = 64;
+    impl->firsts = new bool[impl->firsts_alloc];
+    impl->after_key = false;
+    impl->key_ok_alloc = 1024;
+    impl->key_ok = new char[impl->key_ok_alloc]();
+
+    if ( codec == CODEC_GZIP ) {
+        impl->gz.zalloc = Z_NULL;
+        impl->gz.zfree = Z_NULL;
+        impl->gz.opaque = Z_NULL;
+        if ( deflateInit2( &impl->gz, (level >= 1 && level <= 9) ? level : 6, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY ) != Z_OK ) error( "could not start deflate" );
+        impl->zbuf_len = GZBUF_LEN;
+    }
+#ifdef NODEIO_ZSTD
+    impl->zstd = nullptr;
+    if ( codec == CODEC_ZSTD ) {
+        impl->zstd = ZSTD_createCCtx();
+        if ( impl->zstd == nullptr ) error( "could not start zstd" );
+        ZSTD_CCtx_setParameter( impl->zstd, ZSTD_c_compressionLevel, level );
+        ZSTD_CCtx_setParameter( impl->zstd, ZSTD_c_checksumFlag, 1 );
+        ZSTD_CCtx_setParameter( impl->zstd, ZSTD_c_jobSize, ZFRAME_LEN / 4 );     // the default would give a frame one job
+        impl->zbuf_len = ZSTD_CStreamOutSize();
+        impl->seek_alloc = 64;
+        impl->seeks = new uint32_t[2 * impl->seek_alloc];
+    }
+#endif
+#ifdef NODEIO_LZ4
+    impl->lz4 = nullptr;
+    if ( codec == CODEC_LZ4 ) {
+        if ( LZ4F_isError( LZ4F_createCompressionContext( &impl->lz4, LZ4F_VERSION ) ) ) error( "could not start lz4" );
+        memset( &impl->lz4_prefs, 0, sizeof( impl->lz4_prefs ) );
+        impl->lz4_prefs.compressionLevel = level;
+        impl->lz4_prefs.frameInfo.blockSizeID = LZ4F_max4MB;
+        impl->lz4_prefs.frameInfo.contentChecksumFlag = LZ4F_contentChecksumEnabled;
+        impl->zbuf_len = LZ4F_compressBound( WBUF_LEN, &impl->lz4_prefs );
+    }
+#endif
+    if ( impl->zbuf_len != 0 ) impl->zbuf = new char[impl->zbuf_len];
+}
+
+void NodeIOWriter::threads_set( int cnt )
+{
+    if ( cnt <= 0 ) cnt = std::thread::hardware_concurrency();
+    impl->thread_cnt = (cnt > 0) ? cnt : 1;
+}
+
+//----------------------------------------------------------------
+// Destructor
+//----------------------------------------------------------------
+NodeIOWriter::~NodeIOWriter()
+{
+    dassert( impl->depth == 0 && !impl->after_key );
+    impl->flush();
+    if ( impl->codec != CODEC_NONE ) {
+        if ( impl->frame_open || impl->frame_cnt == 0 ) impl->frame_end();
+        if ( impl->codec == CODEC_ZSTD ) impl->seeks_write();
+    }
+    if ( impl->codec == CODEC_GZIP ) deflateEnd( &impl->gz );
+#ifdef NODEIO_ZSTD
+    if ( impl->zstd != nullptr ) ZSTD_freeCCtx( impl->zstd );
+#endif
+#ifdef NODEIO_LZ4
+    if ( impl->lz4 != nullptr ) LZ4F_freeCompressionContext( impl->lz4 );
+#endif
+    if ( close( impl->fd ) != 0 ) error( "could not finish writing file" );
+    delete[] impl->zbuf;
+    delete[] impl->seeks;
+    delete[] impl->buf;
+    delete[] impl->firsts;
+    delete[] impl->key_ok;
+    delete impl;
+    this->impl = nullptr;
+}
+
+//----------------------------------------------------------------
+// Whole Values
+//----------------------------------------------------------------
+void NodeIOWriter::hash_write( Hash * hash )
+{
+    impl->hash( hash );
+}
+
+void NodeIOWriter::list_write( List * list )
+{
+    impl->list( list );
+}
+
+void NodeIOWriter::val_write( const nVal& v )
+{
+    impl->val( v );
+}
+
+long NodeIOWriter::text_len( void )
+{
+    return impl->flushed_len + impl->buf_pos;
+}
+
+void NodeIOWriter::Impl::val( const nVal& v )
+{
+    switch( v.kind() )
+    {
+        case INT:   this->i( v.i() );       break;
+        case FLT:   this->f( v.f() );       break;
+        case STR:   this->s( v.s() );       break;
+        case HASH:  this->hash( v.hp() );   break;
+        case LIST:  this->list( v.lp() );   break;
+        default:    error( "undefined values can't be written" ); break;
+    }
+}
+
+void NodeIOWriter::Impl::hash( Hash * hash )
+{
+    //---------------------------------------
+    // Undefined properties are left out, since the text
+    // has no way to say that.
+    //---------------------------------------
+    this->open( '{' );
+    int cnt = (hash->mask < 0) ? hash->count : (hash->mask+1);
+    for( int i = 0; i < cnt; i++ )
+    {
+        if ( hash->ids[i] == -1 || hash->vals[i].kind() == UNDEF ) continue;
+        this->key( hash->ids[i] );
+        this->val( hash->vals[i] );
+    }
+    this->close( '}' );
+}
+
+void NodeIOWriter::Impl::list( List * list )
+{
+    this->open( '[' );
+    for( int i = 0; i < list->count; i++ )
+    {
+        switch( list->packed )
+        {
+            case INT:   this->i( list->ints[i] );           break;
+            case FLT:   this->f( list->flts[i] );           break;
+            default:    this->val( list->entries[i] );      break;
+        }
+    }
+    this->close( ']' );
+}
+
+//----------------------------------------------------------------
+// Streaming
+//----------------------------------------------------------------
+bool NodeIOWriter::list_begin( void )   { impl->open( '[' );  return true; }
+bool NodeIOWriter::list_end( void )     { impl->close( ']' ); return true; }
+bool NodeIOWriter::hash_begin( void )   { impl->open( '{' );  return true; }
+bool NodeIOWriter::hash_end( void )     { impl->close( '}' ); return true; }
+bool NodeIOWriter::key( int id )        { impl->key( id );    return true; }
+bool NodeIOWriter::i( nInt v )          { impl->i( v );       return true; }
+bool NodeIOWriter::f( nFlt v )          { impl->f( v );       return true; }
+bool NodeIOWriter::s( nStr v )          { impl->s( v );       return true; }
+
+inline void NodeIOWriter::Impl::sep( void )
+{
+    if ( this->after_key ) {
+        this->after_key = false;
+    } else if ( this->depth != 0 ) {
+        if ( this->firsts[this->depth] ) {
+            this->firsts[this->depth] = false;
+        } else if ( this->depth == 1 ) {
+            this->put( ",\n", 2 );
+        } else {
+            this->put( ", ", 2 );
+        }
+    }
+}
+
+void NodeIOWriter::Impl::open( char c )
+{
+    this->sep();
+    this->depth++;
+    if ( this->depth == this->firsts_alloc ) {
+        bool * new_firsts = new bool[this->firsts_alloc << 1];
+        memcpy( new_firsts, this->firsts, this->firsts_alloc );
+        delete[] this->firsts;
+        this->firsts = new_firsts;
+        this->firsts_alloc <<= 1;
+    }
+    this->firsts[this->depth] = true;
+    this->put( c );
+    if ( this->depth == 1 ) {
+        this->put( '\n' );
+    } else if ( c == '{' ) {
+        this->put( ' ' );
+    }
+}
+
+void NodeIOWriter::Impl::close( char c )
+{
+    dassert( this->depth > 0 && !this->after_key );
+    bool empty = this->firsts[this->depth];
+    if ( this->depth == 1 ) {
+        if ( !empty ) this->put( '\n' );
+        this->put( c );
+        this->put( '\n' );
+    } else {
+        if ( c == '}' ) this->put( ' ' );
+        this->put( c );
+    }
+    this->depth--;
+}
+
+void NodeIOWriter::Impl::key( int id )
+{
+    dassert( this->depth > 0 && !this->after_key );
+    if ( id >= this->key_ok_alloc ) {
+        int new_alloc = this->key_ok_alloc << 1;
+        while( new_alloc <= id ) new_alloc <<= 1;
+        char * new_ok = new char[new_alloc]();
+        memcpy( new_ok, this->key_ok, this->key_ok_alloc );
+        delete[] this->key_ok;
+        this->key_ok = new_ok;
+        this->key_ok_alloc = new_alloc;
+    }
+    nStr name = Hash::id_to_str( id );
+    if ( this->key_ok[id] == 0 ) {
+        bool ok = (name[0] >= 'a' && name[0] <= 'z') || (name[0] >= 'A' && name[0] <= 'Z') || name[0] == '_';
+        for( const char * p = name; ok && *p != '\0'; p++ )
+        {
+            ok = (*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_';
+        }
+        this->key_ok[id] = ok ? 1 : 2;
+    }
+    if ( this->key_ok[id] != 1 ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "property name '%s' is not an identifier, so it can't be written", name );
+        error( msg );
+    }
+    this->sep();
+    this->put( name, strlen( name ) );
+    this->put( ": ", 2 );
+    this->after_key = true;
+}
+
+void NodeIOWriter::Impl::i( nInt v )
+{
+    char   s[24];
+    char * end = s + sizeof( s );
+    char * p   = end;
+    uint64_t u = (v < 0) ? (0 - uint64_t( v )) : uint64_t( v );
+    do
+    {
+        *--p = '0' + (u % 10);
+        u /= 10;
+    } while( u != 0 );
+    if ( v < 0 ) *--p = '-';
+    this->sep();
+    this->put( p, end - p );
+}
+
+void NodeIOWriter::Impl::f( nFlt v )
+{
+    //---------------------------------------
+    // The grammar has no exponents, infinities or NaNs, and NodeIO
+    // builds both halves of a number in an nInt.  So write plain
+    // decimal, with the fewest significant digits that read back the
+    // same, or else with 18 places after the point for tiny values.
+    //---------------------------------------
+    if ( !isfinite( v ) || fabs( v ) >= 1e18 ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "float %g can't be written, it must be finite and less than 1e18", v );
+        error( msg );
+    }
+    char s[64];
+    int  len = 0;
+    for( int prec = 15; prec <= 17; prec++ )
+    {
+        len = snprintf( s, sizeof( s ), "%.*g", prec, v );
+        if ( strtod( s, nullptr ) == v ) break;
+    }
+    if ( strchr( s, 'e' ) != nullptr ) {
+        len = snprintf( s, sizeof( s ), "%.18f", v );
+        while( s[len-1] == '0' && s[len-2] != '.' ) len--;
+    } else if ( strchr( s, '.' ) == nullptr ) {
+        s[len++] = '.';
+        s[len++] = '0';
+    }
+    this->sep();
+    this->put( s, len );
+}
+
+void NodeIOWriter::Impl::s( nStr v )
+{
+    //---------------------------------------
+    // Only '"' and '\' need escaping.  A literal can't span lines,
+    // even escaped, so strings with newlines can't be written.
+    //---------------------------------------
+    this->sep();
+    this->put( '"' );
+    for( ;; )
+    {
+        size_t len = strcspn( v, "\"\\\n" );
+        this->put( v, len );
+        v += len;
+        if ( *v == '\0' ) break;
+        if ( *v == '\n' ) error( "strings with newlines can't be written" );
+        this->put( '\\' );
+        this->put( *v++ );
+    }
+    this->put( '"' );
+}
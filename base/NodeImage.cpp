@@ -0,0 +1,560 @@
+// Copyright (c) 2017-2018 Robert A. Alfieri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Misc.h"
+#include "Node.h"
+#include "errno.h"
+#include <new>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#undef dprintf
+#define dprintf if ( 0 ) printf
+
+//---------------------------------------
+// Node Image Format
+//
+// An image holds the tree's Hash and List objects, their out-of-line
+// arrays and their strings, byte for byte as this build lays them out
+// in memory, with every pointer set for the image being mapped at one
+// preferred address (base).  Opening one is an mmap() at base; nothing is
+// parsed or allocated, and pages come in as the nodes are touched.
+//
+// Three things force a pass over the nodes when the image is opened:
+//
+//     - base is taken, so the image lands elsewhere and every pointer is
+//       moved by the difference.
+//     - Property ids belong to a process.  The image keeps the name of
+//       each id its hashes use, and these are interned in id order when it
+//       is opened.  In a process that hasn't interned anything else yet,
+//       the ids come out the same; otherwise the hashes are rewritten.
+//     - The reader pools string values (NodeIO::str_pool_set()).  Pooled
+//       strings are written like any other, so each string value is 
+//       swapped for its Hash::str_pooled() copy, and compares equal by
+//       address to strings pooled by the process.
+//
+// After the header, the file is a sequence of records, each a RecHdr
+// followed by one string, or one Hash or List and its arrays.  Children
+// come before parents, and a node or string reached twice is written
+// once.  Every Hash and List points at an nArena that is constructed in
+// the header on open, so they can be changed like any other arena node.
+//
+// Images only suit the build that wrote them (object sizes, NODE_NANBOX,
+// byte order).  They are a cache for the text, not a replacement.
+//---------------------------------------
+static const char IMAGE_MAGIC[8] = { '\0', 'N', 'O', 'D', 'E', 'I', 'M', 'G' };  // no text file starts with NUL
+const uint32_t    IMAGE_VERSION  = 1;
+const uint32_t    IMAGE_ORDER    = 0x01020304;                  // reads back differently in the other byte order
+const uint64_t    IMAGE_BASE     = 0x100000000000ULL;           // preferred addresses start here...
+const int         IMAGE_BASE_SHIFT = 34;                        // ...and are 16GB apart
+const int         IMAGE_BASE_CNT   = 1024;
+
+enum
+{
+    REC_STR     = 1,
+    REC_HASH    = 2,
+    REC_LIST    = 3,
+    REC_KEYS    = 4,
+};
+
+class RecHdr
+{
+public:
+    uint32_t    kind;                           // REC_*
+    uint32_t    pad;
+    uint64_t    len;                            // whole record, a multiple of 8
+};
+
+class ImageHdr
+{
+public:
+    char        magic[8];                       // IMAGE_MAGIC
+    uint32_t    version;                        // IMAGE_VERSION
+    uint32_t    order;                          // IMAGE_ORDER
+    uint16_t    val_len;                        // sizeof( nVal )
+    uint16_t    hash_len;                       // sizeof( Hash )
+    uint16_t    list_len;                       // sizeof( List )
+    uint16_t    arena_len;                      // sizeof( nArena )
+    uint64_t    base;                           // address the image is laid out for
+    uint64_t    len;                            // file length
+    uint64_t    nodes_end;                      // offset past the last node record
+    uint64_t    keys;                           // address of the key table: name of each id, 0 if unused
+    int64_t     key_cnt;                        // entries in it
+    nVal        root;                           // the HASH or LIST written
+    alignas( 8 ) char arena[sizeof( nArena )];  // every node's arena, constructed when opened
+};
+
+const uint64_t IMAGE_NODES = (sizeof( ImageHdr ) + 7) & ~7ULL;    // first record
+
+template<class T> static inline T * moved( T * p, intptr_t delta )
+{
+    return reinterpret_cast<T *>( reinterpret_cast<intptr_t>( p ) + delta );
+}
+
+//---------------------------------------
+// Writer
+//
+// Records are appended to the file as they are finished, so memory use
+// doesn't depend on the size of the tree.  seen remembers the offset of
+// everything written, by address, in an open-addressed table.
+//---------------------------------------
+class ImageSeen
+{
+public:
+    const void *        p;                      // node or string, nullptr means unused
+    uint64_t            off;                    // where it was written
+};
+
+class nImage::Writer
+{
+public:
+    FILE *              file;
+    uint64_t            base;                   // preferred address
+    uint64_t            pos;                    // file length so far
+    ImageSeen *         seen;
+    int                 seen_mask;              // allocated entries-1
+    int                 seen_cnt;               // entries used
+    bool *              key_used;               // by id
+    int                 key_alloc;              // entries allocated
+
+    template<class T> T * at( uint64_t off ) { return reinterpret_cast<T *>( this->base + off ); }
+    void                put( const void * p, size_t len );                      // append, padded to 8 bytes
+    uint64_t            rec_put( uint32_t kind, size_t len );                   // append a RecHdr, return where the payload goes
+    uint64_t            seen_find( const void * p );                            // offset, or 0 if not written yet
+    void                seen_add( const void * p, uint64_t off );
+    void                key_use( int id );
+
+    nVal                val_put( const nVal& v );                               // write what v points to, return v as it reads in the image
+    uint64_t            str_put( nStr s );
+    uint64_t            hash_put( Hash * hash );
+    uint64_t            list_put( List * list );
+};
+
+void nImage::Writer::put( const void * p, size_t len )
+{
+    static const char zeros[8] = { 0 };
+    size_t pad = (8 - (len & 7)) & 7;
+    if ( fwrite( p, 1, len, this->file ) != len || fwrite( zeros, 1, pad, this->file ) != pad ) {
+        char msg[256];
+        snprintf( msg, sizeof( msg ), "could not write node image, errno=%d", errno );
+        error( msg );
+    }
+    this->pos += len + pad;
+}
+
+uint64_t nImage::Writer::rec_put( uint32_t kind, size_t len )
+{
+    RecHdr rec;
+    rec.kind = kind;
+    rec.pad  = 0;
+    rec.len  = sizeof( RecHdr ) + ((len + 7) & ~size_t( 7 ));
+    this->put( &rec, sizeof( rec ) );
+    return this->pos;
+}
+
+uint64_t nImage::Writer::seen_find( const void * p )
+{
+    for( int i = (reinterpret_cast<uintptr_t>( p ) >> 3) & this->seen_mask; ; i = (i+1) & this->seen_mask )
+    {
+        if ( this->seen[i].p == p ) return this->seen[i].off;
+        if ( this->seen[i].p == nullptr ) return 0;
+    }
+}
+
+void nImage::Writer::seen_add( const void * p, uint64_t off )
+{
+    if ( (this->seen_cnt+1)*2 > (this->seen_mask+1) ) {
+        ImageSeen * old_seen = this->seen;
+        int old_cnt = this->seen_mask+1;
+        this->seen_mask = (old_cnt << 1) - 1;
+        this->seen = new ImageSeen[old_cnt << 1]();
+        this->seen_cnt = 0;
+        for( int i = 0; i < old_cnt; i++ )
+        {
+            if ( old_seen[i].p != nullptr ) this->seen_add( old_seen[i].p, old_seen[i].off );
+        }
+        delete[] old_seen;
+    }
+    int i = (reinterpret_cast<uintptr_t>( p ) >> 3) & this->seen_mask;
+    while( this->seen[i].p != nullptr ) i = (i+1) & this->seen_mask;
+    this->seen[i].p = p;
+    this->seen[i].off = off;
+    this->seen_cnt++;
+}
+
+void nImage::Writer::key_use( int id )
+{
+    if ( id >= this->key_alloc ) {
+        int new_alloc = this->key_alloc << 1;
+        while( new_alloc <= id ) new_alloc <<= 1;
+        bool * new_used = new bool[new_alloc]();
+        memcpy( new_used, this->key_used, this->key_alloc );
+        delete[] this->key_used;
+        this->key_used = new_used;
+        this->key_alloc = new_alloc;
+    }
+    this->key_used[id] = true;
+}
+
+nVal nImage::Writer::val_put( const nVal& v )
+{
+    nVal w = v;
+    switch( v.kind() )
+    {
+        case STR:   w.s( this->at<const char>( this->str_put( v.s() ) ) );     break;
+        case HASH:  w.hp( this->at<Hash>( this->hash_put( v.hp() ) ) );        break;
+        case LIST:  w.lp( this->at<List>( this->list_put( v.lp() ) ) );        break;
+        default:                                                                break;
+    }
+    return w;
+}
+
+uint64_t nImage::Writer::str_put( nStr s )
+{
+    uint64_t off = this->seen_find( s );
+    if ( off != 0 ) return off;
+
+    size_t len = strlen( s ) + 1;
+    off = this->rec_put( REC_STR, len );
+    this->put( s, len );
+    this->seen_add( s, off );
+    return off;
+}
+
+uint64_t nImage::Writer::hash_put( Hash * hash )
+{
+    uint64_t off = this->seen_find( hash );
+    if ( off != 0 ) return off;
+
+    //---------------------------------------
+    // Values first, since they are written before us.  A shaped hash
+    // is written as an inline one, since shapes live in the process.
+    //---------------------------------------
+    bool   table    = hash->mask >= 0;
+    int    slot_cnt = table ? (hash->mask+1) : Hash::INLINE_CNT;
+    nVal * vals     = new nVal[slot_cnt];
+    for( int i = 0; i < slot_cnt; i++ )
+    {
+        int id = (table || i < hash->count) ? hash->ids[i] : -1;
+        if ( id != -1 ) {
+            this->key_use( id );
+            vals[i] = this->val_put( hash->vals[i] );
+        } else {
+            vals[i].undef();
+        }
+    }
+
+    size_t ids_len = table ? (((slot_cnt + Hash::INLINE_CNT-1) * sizeof( int ) + 7) & ~size_t( 7 )) : 0;  // with the mirrored tail
+    size_t len     = sizeof( Hash ) + ids_len + (table ? (slot_cnt * sizeof( nVal )) : 0);
+    off = this->rec_put( REC_HASH, len );
+
+    alignas( Hash ) char obj[sizeof( Hash )];
+    memcpy( obj, static_cast<void *>( hash ), sizeof( Hash ) );
+    Hash * h = reinterpret_cast<Hash *>( obj );
+    h->arena = this->at<nArena>( offsetof( ImageHdr, arena ) );
+    if ( hash->mask == Hash::MASK_SHAPED ) {
+        memcpy( h->inline_ids, hash->ids, sizeof( h->inline_ids ) );
+        h->mask = Hash::MASK_INLINE;
+    }
+    if ( table ) {
+        h->ids  = this->at<int>( off + sizeof( Hash ) );
+        h->vals = this->at<nVal>( off + sizeof( Hash ) + ids_len );
+    } else {
+        h->ids  = this->at<int>( off + (reinterpret_cast<char *>( h->inline_ids ) - obj) );
+        h->vals = this->at<nVal>( off + (reinterpret_cast<char *>( h->inline_vals ) - obj) );
+        for( int i = 0; i < slot_cnt; i++ ) h->inline_vals[i] = vals[i];
+    }
+    this->put( obj, sizeof( Hash ) );
+    if ( table ) {
+        this->put( hash->ids, (slot_cnt + Hash::INLINE_CNT-1) * sizeof( int ) );
+        this->put( vals, slot_cnt * sizeof( nVal ) );
+    }
+    delete[] vals;
+    this->seen_add( hash, off );
+    return off;
+}
+
+uint64_t nImage::Writer::list_put( List * list )
+{
+    uint64_t off = this->seen_find( list );
+    if ( off != 0 ) return off;
+
+    //---------------------------------------
+    // Entries that have outgrown the object are written right after it,
+    // exactly as many as are used (at least one, so the list can grow).
+    //---------------------------------------
+    bool   packed    = list->packed != UNDEF;
+    size_t entry_len = packed ? sizeof( nInt ) : sizeof( nVal );
+    size_t entries_at = list->bytes - reinterpret_cast<char *>( list );          // from the object, if inline
+    bool   in_obj    = (list->bytes - list->head*entry_len) == reinterpret_cast<char *>( list->inline_entries );
+    int    cnt       = list->count;
+    int    arr_cnt   = in_obj ? 0 : ((cnt > 0) ? cnt : 1);
+    nVal * vals      = packed ? nullptr : new nVal[(cnt > 0) ? cnt : 1];
+    for( int i = 0; !packed && i < cnt; i++ )
+    {
+        vals[i] = this->val_put( list->entries[i] );
+    }
+    if ( !packed && cnt == 0 ) vals[0].undef();
+
+    off = this->rec_put( REC_LIST, sizeof( List ) + arr_cnt*entry_len );
+
+    alignas( List ) char obj[sizeof( List )];
+    memcpy( obj, static_cast<void *>( list ), sizeof( List ) );
+    List * l = reinterpret_cast<List *>( obj );
+    l->arena = this->at<nArena>( offsetof( ImageHdr, arena ) );
+    if ( in_obj ) {
+        l->bytes = this->at<char>( off + entries_at );
+        if ( !packed ) {
+            nVal * e = reinterpret_cast<nVal *>( obj + entries_at );
+            for( int i = 0; i < cnt; i++ ) e[i] = vals[i];
+        }
+    } else {
+        l->head        = 0;
+        l->alloc_count = arr_cnt;
+        l->bytes       = this->at<char>( off + sizeof( List ) );
+    }
+    this->put( obj, sizeof( List ) );
+    if ( !in_obj ) {
+        if ( packed ) {
+            nInt zero = 0;
+            this->put( (cnt > 0) ? static_cast<const void *>( list->bytes ) : &zero, arr_cnt*entry_len );
+        } else {
+            this->put( vals, arr_cnt*entry_len );
+        }
+    }
+    delete[] vals;
+    this->seen_add( list, off );
+    return off;
+}
+
+//---------------------------------------
+// Write
+//---------------------------------------
+void nImage::write( const char * file_path, List * list )
+{
+    nVal root;
+    root.lp( list );
+    nImage::write( file_path, root );
+}
+
+void nImage::write( const char * file_path, Hash * hash )
+{
+    nVal root;
+    root.hp( hash );
+    nImage::write( file_path, root );
+}
+
+void nImage::write( const char * file_path, const nVal& root )
+{
+    Writer w;
+    w.file = fopen( file_path, "w" );
+    if ( w.file == nullptr ) {
+        char msg[256];
+        snprintf( msg, sizeof( msg ), "could not open file %s for writing, errno=%d", file_path, errno );
+        error( msg );
+    }
+
+    //---------------------------------------
+    // Different paths prefer different addresses, so that
+    // a few images open together don't collide.
+    //---------------------------------------
+    uint64_t path_hash = 14695981039346656037ULL;
+    for( const char * p = file_path; *p != '\0'; p++ ) path_hash = (path_hash ^ uint8_t( *p )) * 1099511628211ULL;
+    w.base      = IMAGE_BASE + ((path_hash % IMAGE_BASE_CNT) << IMAGE_BASE_SHIFT);
+    w.pos       = 0;
+    w.seen_mask = 1023;
+    w.seen_cnt  = 0;
+    w.seen      = new ImageSeen[w.seen_mask+1]();
+    w.key_alloc = 1024;
+    w.key_used  = new bool[w.key_alloc]();
+
+    ImageHdr hdr;
+    memset( static_cast<void *>( &hdr ), 0, sizeof( hdr ) );
+    w.put( &hdr, sizeof( hdr ) );                       // filled in at the end
+    hdr.root = w.val_put( root );
+
+    int key_cnt = 0;
+    for( int id = 0; id < w.key_alloc; id++ )
+    {
+        if ( w.key_used[id] ) key_cnt = id+1;
+    }
+    uint64_t * keys = new uint64_t[key_cnt > 0 ? key_cnt : 1];
+    for( int id = 0; id < key_cnt; id++ )
+    {
+        keys[id] = w.key_used[id] ? reinterpret_cast<uint64_t>( w.at<char>( w.str_put( Hash::id_to_str( id ) ) ) ) : 0;
+    }
+    hdr.nodes_end = w.pos;
+    hdr.keys = reinterpret_cast<uint64_t>( w.at<char>( w.rec_put( REC_KEYS, key_cnt * sizeof( uint64_t ) ) ) );
+    w.put( keys, key_cnt * sizeof( uint64_t ) );
+
+    memcpy( hdr.magic, IMAGE_MAGIC, sizeof( hdr.magic ) );
+    hdr.version   = IMAGE_VERSION;
+    hdr.order     = IMAGE_ORDER;
+    hdr.val_len   = sizeof( nVal );
+    hdr.hash_len  = sizeof( Hash );
+    hdr.list_len  = sizeof( List );
+    hdr.arena_len = sizeof( nArena );
+    hdr.base      = w.base;
+    hdr.len       = w.pos;
+    hdr.key_cnt   = key_cnt;
+    if ( fseek( w.file, 0, SEEK_SET ) != 0 || fwrite( &hdr, 1, sizeof( hdr ), w.file ) != sizeof( hdr ) || fclose( w.file ) != 0 ) {
+        error( "could not finish writing node image" );
+    }
+    delete[] keys;
+    delete[] w.key_used;
+    delete[] w.seen;
+}
+
+//---------------------------------------
+// Open
+//
+// Returns nullptr, leaving NodeIO to read the file as text, if it
+// doesn't start with IMAGE_MAGIC.
+//---------------------------------------
+nImage * nImage::open( const char * file_path )
+{
+    int fd = ::open( file_path, O_RDONLY );
+    if ( fd < 0 ) return nullptr;
+
+    struct stat st;
+    ImageHdr hdr;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || size_t( st.st_size ) < sizeof( hdr ) ||
+         pread( fd, &hdr, sizeof( hdr ), 0 ) != sizeof( hdr ) || memcmp( hdr.magic, IMAGE_MAGIC, sizeof( hdr.magic ) ) != 0 ) {
+        close( fd );
+        return nullptr;
+    }
+    if ( hdr.version != IMAGE_VERSION || hdr.order != IMAGE_ORDER || hdr.val_len != sizeof( nVal ) || hdr.hash_len != sizeof( Hash ) ||
+         hdr.list_len != sizeof( List ) || hdr.arena_len != sizeof( nArena ) || hdr.len != uint64_t( st.st_size ) ) {
+        char msg[256];
+        snprintf( msg, sizeof( msg ), "node image %s was written by a different build or is truncated; write it again", file_path );
+        error( msg );
+    }
+
+    void * addr = mmap( reinterpret_cast<void *>( hdr.base ), hdr.len, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( addr == MAP_FAILED ) {
+        char msg[256];
+        snprintf( msg, sizeof( msg ), "could not map node image %s, errno=%d", file_path, errno );
+        error( msg );
+    }
+    dprintf( "image %s: %s base\n", file_path, (addr == reinterpret_cast<void *>( hdr.base )) ? "at" : "not at" );
+
+    nImage * image = new nImage;
+    image->addr    = static_cast<char *>( addr );
+    image->len     = hdr.len;
+    image->adopted = false;
+    return image;
+}
+
+nImage::~nImage()
+{
+    if ( !this->adopted ) munmap( this->addr, this->len );
+}
+
+//---------------------------------------
+// Root
+//
+// Does whatever fixing up is needed (see Node Image Format), then
+// starts the image's own arena and gives the mapping to arena.
+//---------------------------------------
+nVal nImage::root( nArena * arena, bool str_pool )
+{
+    if ( arena == nullptr ) error( "node images need an arena, see NodeIO::arena_set()" );
+    if ( this->adopted ) error( "node image root was already taken" );
+
+    ImageHdr * hdr   = reinterpret_cast<ImageHdr *>( this->addr );
+    intptr_t   delta = reinterpret_cast<intptr_t>( this->addr ) - intptr_t( hdr->base );
+
+    const uint64_t * keys = reinterpret_cast<const uint64_t *>( hdr->keys + delta );
+    int * id_map  = new int[(hdr->key_cnt > 0) ? hdr->key_cnt : 1];
+    bool  same_ids = true;
+    for( int id = 0; id < hdr->key_cnt; id++ )
+    {
+        id_map[id] = (keys[id] != 0) ? Hash::str_to_id( reinterpret_cast<nStr>( keys[id] + delta ) ) : -1;
+        same_ids = same_ids && (keys[id] == 0 || id_map[id] == id);
+    }
+
+    if ( delta != 0 || !same_ids || str_pool ) {
+        madvise( this->addr, hdr->nodes_end, MADV_SEQUENTIAL );
+        for( uint64_t off = IMAGE_NODES; off < hdr->nodes_end; )
+        {
+            const RecHdr * rec = reinterpret_cast<const RecHdr *>( this->addr + off );
+            char *         obj = this->addr + off + sizeof( RecHdr );
+            switch( rec->kind )
+            {
+                case REC_HASH:  nImage::hash_fix( reinterpret_cast<Hash *>( obj ), delta, same_ids ? nullptr : id_map, str_pool ); break;
+                case REC_LIST:  nImage::list_fix( reinterpret_cast<List *>( obj ), delta, str_pool );                             break;
+                default:                                                                                                break;
+            }
+            off += rec->len;
+        }
+        madvise( this->addr, hdr->nodes_end, MADV_NORMAL );
+        nImage::val_fix( hdr->root, delta, str_pool );
+    }
+    delete[] id_map;
+
+    nArena * inner = new( hdr->arena ) nArena;
+    arena->map_adopt( this->addr, this->len, inner );
+    this->adopted = true;
+    return hdr->root;
+}
+
+void nImage::val_fix( nVal& v, intptr_t delta, bool str_pool )
+{
+    switch( v.kind() )
+    {
+        case STR:   v.s( str_pool ? Hash::str_pooled( moved( v.s(), delta ) ) : moved( v.s(), delta ) ); break;
+        case HASH:  v.hp( moved( v.hp(), delta ) );    break;
+        case LIST:  v.lp( moved( v.lp(), delta ) );    break;
+        default:                                        break;
+    }
+}
+
+void nImage::hash_fix( Hash * hash, intptr_t delta, const int * id_map, bool str_pool )
+{
+    if ( delta != 0 ) {
+        hash->arena = moved( hash->arena, delta );
+        hash->ids   = moved( hash->ids, delta );
+        hash->vals  = moved( hash->vals, delta );
+    }
+    if ( delta != 0 || str_pool ) {
+        int slot_cnt = (hash->mask >= 0) ? (hash->mask+1) : hash->count;
+        for( int i = 0; i < slot_cnt; i++ )
+        {
+            if ( hash->ids[i] != -1 ) nImage::val_fix( hash->vals[i], delta, str_pool );
+        }
+    }
+    if ( id_map != nullptr ) hash->ids_remap( id_map );
+}
+
+void nImage::list_fix( List * list, intptr_t delta, bool str_pool )
+{
+    if ( delta == 0 && !str_pool ) return;
+    list->arena = moved( list->arena, delta );
+    list->bytes = moved( list->bytes, delta );
+    for( int i = 0; list->packed == UNDEF && i < list->count; i++ )
+    {
+        nImage::val_fix( list->entries[i], delta, str_pool );
+    }
+}
@@ -0,0 +1,772 @@
+// Copyright (c) 2017-2018 Robert A. Alfieri
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+
+#include "Misc.h"
+#include "Node.h"
+#include "zlib.h"
+#include "errno.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef NODEIO_ZSTD
+#include <zstd.h>
+#endif
+#ifdef NODEIO_LZ4
+#include <lz4frame.h>
+#endif
+
+#undef dprintf
+#define dprintf if ( 0 ) printf
+
+//---------------------------------------
+// Node Index Format
+//
+// For a file f, the index f.idx lets NodeIO start reading at any element
+// of f's top-level list.  Offsets are into f's text, after decompression.
+// The index has:
+//
+//     - the offset and line of each element.  An element starts just past
+//       the '[' or ',' in front of it, so the scanner can be dropped there
+//       as if it had just taken that token.
+//     - for a gzipped f, restart points about every span bytes of text,
+//       as in zlib's zran.c: a deflate block boundary in f, the bits of the
+//       byte before it that belong to the block, and the 32KB of text in
+//       front of it, which inflate needs as its dictionary.  Windows are
+//       stored deflated.  The start of each gzip member after the first is
+//       a point too if it comes at the right distance; it needs no window.
+//     - for a zstd or lz4 f, the starts of frames at the right distance.
+//       Frames don't depend on each other, so that is all a point needs.
+//       NodeIOWriter cuts such files into frames of a few MB.
+//
+// Reading from offset off restarts decompression at the last point at or
+// before off and throws away the text before off.
+//
+// The index records the length and modification time of the f it was
+// built from.  If f changes, open() ignores the index until it is written 
+// again.
+//
+// After the header come the elements, then the deflated windows, then 
+// the points.  The header is written last, so a partly written index is
+// never picked up.
+//---------------------------------------
+static const char INDEX_MAGIC[8] = { 'N', 'O', 'D', 'E', 'I', 'D', 'X', '\0' };
+const uint32_t    INDEX_VERSION  = 1;
+const uint32_t    INDEX_ORDER    = 0x01020304;   // reads back differently in the other byte order
+const int         WINDOW_LEN     = 32768;        // inflate's dictionary
+const int         IN_LEN         = 1 << 16;      // compressed bytes read at a time
+const int         MSG_LEN        = 256;
+
+enum
+{
+    POINT_START  = 0,                            // a gzip member or a zstd or lz4 frame starts at in
+    POINT_BLOCK  = 1,                            // a deflate block starts at in, bits before it
+};
+
+class IndexHdr
+{
+public:
+    char        magic[8];                        // INDEX_MAGIC
+    uint32_t    version;                         // INDEX_VERSION
+    uint32_t    order;                           // INDEX_ORDER
+    uint64_t    file_len;                        // length of f when indexed
+    int64_t     file_sec;                        // modification time of f
+    int64_t     file_nsec;
+    uint64_t    text_len;                        // length of f's text
+    uint64_t    span;                            // text between points
+    uint32_t    codec;                           // nCodec of f
+    uint32_t    pad;
+    int64_t     elem_cnt;
+    uint64_t    elems;                           // offset of the IndexElem table
+    uint64_t    windows;                         // offset of the deflated windows
+    int64_t     point_cnt;
+    uint64_t    points;                          // offset of the IndexPoint table
+    uint64_t    len;                             // index file length
+};
+
+class IndexElem
+{
+public:
+    uint64_t    off;                             // text offset
+    int64_t     line;
+};
+
+class IndexPoint
+{
+public:
+    uint64_t    text_off;                        // text offset
+    uint64_t    in_off;                          // offset in f
+    uint64_t    window;                          // offset of the deflated window, from hdr.windows
+    uint32_t    window_len;                      // its length
+    uint16_t    kind;                            // POINT_*
+    uint16_t    bits;                            // POINT_BLOCK: bits of in_off-1 that are in the block
+};
+
+static void index_path( char * path, int path_len, const char * file_path )
+{
+    if ( snprintf( path, path_len, "%s.idx", file_path ) >= path_len ) error( "file path is too long for an index" );
+}
+
+static void file_mtime( const struct stat& st, int64_t& sec, int64_t& nsec )
+{
+    //---------------------------------------
+    // macOS names the field differently.
+    //---------------------------------------
+#ifdef __APPLE__
+    sec  = st.st_mtimespec.tv_sec;
+    nsec = st.st_mtimespec.tv_nsec;
+#else
+    sec  = st.st_mtim.tv_sec;
+    nsec = st.st_mtim.tv_nsec;
+#endif
+}
+
+//---------------------------------------
+// Stream
+//
+// Compressed input is read with pread(), so the file offset of what
+// has been consumed is always known.  zs.next_in and zs.avail_in keep 
+// track of the input whatever the codec.
+//
+// Besides the usual gzip members, inflate may be started on raw deflate 
+// data at a POINT_BLOCK, whose member trailer it then leaves for 
+// member_next() to skip.  zstd and lz4 go a decoder call at a time
+// through frame_step(), so that write() can see where frames end.
+//---------------------------------------
+class nIndex::Stream
+{
+public:
+    Stream( int fd, nCodec codec );
+    ~Stream();
+
+    int                 fd;                     // f
+    nCodec              codec;                  // CODEC_GZIP, CODEC_ZSTD or CODEC_LZ4
+    uint64_t            pos;                    // offset in f of the byte after in[avail_in]
+    bool                raw;                    // inflating deflate data, without the gzip wrapper
+    bool                frame_open;             // zstd or lz4: the frame being decoded hasn't ended
+    bool                done;                   // the last member or frame has ended
+    z_stream            zs;
+#ifdef NODEIO_ZSTD
+    ZSTD_DCtx *         zstd;
+#endif
+#ifdef NODEIO_LZ4
+    LZ4F_dctx *         lz4;
+#endif
+    unsigned char       in[IN_LEN];
+
+    bool                need( unsigned n );     // make n bytes available at zs.next_in, false if f ends first
+    uint64_t            in_off( void );         // offset in f of zs.next_in
+    void                start( uint64_t off, bool raw );    // restart decompression at off in f
+    bool                member_next( void );    // after Z_STREAM_END, start the next member if there is one
+    int                 frame_step( unsigned char * out, int len );     // zstd or lz4: one decoder call, up to len chars out
+};
+
+nIndex::Stream::Stream( int fd, nCodec codec )
+{
+    char msg[MSG_LEN];
+    if ( !NodeIO::codec_built( codec ) ) {
+        snprintf( msg, MSG_LEN, "this build can't read %s files (see NodeIO.cpp)", (codec == CODEC_ZSTD) ? "zstd" : "lz4" );
+        error( msg );
+    }
+    this->fd = fd;
+    this->codec = codec;
+    this->zs.zalloc = Z_NULL;
+    this->zs.zfree = Z_NULL;
+    this->zs.opaque = Z_NULL;
+    this->zs.next_in = this->in;
+    this->zs.avail_in = 0;
+    if ( inflateInit2( &this->zs, 31 ) != Z_OK ) error( "could not start inflate" );
+#ifdef NODEIO_ZSTD
+    this->zstd = nullptr;
+    if ( codec == CODEC_ZSTD && (this->zstd = ZSTD_createDCtx()) == nullptr ) error( "could not start zstd" );
+#endif
+#ifdef NODEIO_LZ4
+    this->lz4 = nullptr;
+    if ( codec == CODEC_LZ4 && LZ4F_isError( LZ4F_createDecompressionContext( &this->lz4, LZ4F_VERSION ) ) ) error( "could not start lz4" );
+#endif
+    this->start( 0, false );
+}
+
+nIndex::Stream::~Stream()
+{
+    inflateEnd( &this->zs );
+#ifdef NODEIO_ZSTD
+    if ( this->zstd != nullptr ) ZSTD_freeDCtx( this->zstd );
+#endif
+#ifdef NODEIO_LZ4
+    if ( this->lz4 != nullptr ) LZ4F_freeDecompressionContext( this->lz4 );
+#endif
+}
+
+bool nIndex::Stream::need( unsigned n )
+{
+    if ( this->zs.avail_in >= n ) return true;
+    memmove( this->in, this->zs.next_in, this->zs.avail_in );
+    this->zs.next_in = this->in;
+    while( this->zs.avail_in < n )
+    {
+        ssize_t len = pread( this->fd, this->in + this->zs.avail_in, IN_LEN - this->zs.avail_in, this->pos );
+        if ( len < 0 && errno == EINTR ) continue;
+        if ( len < 0 ) {
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "could not read compressed file, errno=%d", errno );
+            error( msg );
+        }
+        if ( len == 0 ) return false;
+        this->zs.avail_in += len;
+        this->pos += len;
+    }
+    return true;
+}
+
+inline uint64_t nIndex::Stream::in_off( void )
+{
+    return this->pos - this->zs.avail_in;
+}
+
+void nIndex::Stream::start( uint64_t off, bool raw )
+{
+    this->pos = off;
+    this->zs.next_in = this->in;
+    this->zs.avail_in = 0;
+    this->raw = raw;
+    this->frame_open = false;
+    this->done = false;
+    switch( this->codec )
+    {
+        case CODEC_GZIP:
+            if ( inflateReset2( &this->zs, raw ? -15 : 31 ) != Z_OK ) error( "could not restart inflate" );
+            break;
+#ifdef NODEIO_ZSTD
+        case CODEC_ZSTD:
+            ZSTD_DCtx_reset( this->zstd, ZSTD_reset_session_only );
+            break;
+#endif
+#ifdef NODEIO_LZ4
+        case CODEC_LZ4:
+            LZ4F_resetDecompressionContext( this->lz4 );
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+bool nIndex::Stream::member_next( void )
+{
+    if ( this->raw ) {
+        if ( !this->need( 8 ) ) return false;                               // CRC and length, unchecked
+        this->zs.next_in  += 8;
+        this->zs.avail_in -= 8;
+    }
+    if ( !this->need( 2 ) || this->zs.next_in[0] != 0x1f || this->zs.next_in[1] != 0x8b ) return false;   // gzread() ignores trailing junk too
+    this->start( this->in_off(), false );
+    return true;
+}
+
+int nIndex::Stream::frame_step( unsigned char * out, int len )
+{
+    //---------------------------------------
+    // Decoders return 0 once a frame is done and all of it is out.
+    // Until then, they may have output left even without more input.
+    //---------------------------------------
+    bool more = this->need( 1 );
+    if ( !more && !this->frame_open ) {
+        this->done = true;
+        return 0;
+    }
+    size_t in_len  = this->zs.avail_in;
+    size_t out_len = len;
+    size_t hint    = 0;
+    const char * err = nullptr;
+    switch( this->codec )
+    {
+#ifdef NODEIO_ZSTD
+        case CODEC_ZSTD:
+        {
+            ZSTD_inBuffer  zin  = { this->zs.next_in, in_len, 0 };
+            ZSTD_outBuffer zout = { out, out_len, 0 };
+            hint = ZSTD_decompressStream( this->zstd, &zout, &zin );
+            if ( ZSTD_isError( hint ) ) err = ZSTD_getErrorName( hint );
+            in_len  = zin.pos;
+            out_len = zout.pos;
+            break;
+        }
+#endif
+#ifdef NODEIO_LZ4
+        case CODEC_LZ4:
+            hint = LZ4F_decompress( this->lz4, out, &out_len, this->zs.next_in, &in_len, nullptr );
+            if ( LZ4F_isError( hint ) ) err = LZ4F_getErrorName( hint );
+            break;
+#endif
+        default:
+            err = "unknown codec";
+            break;
+    }
+    if ( err == nullptr && !more && out_len == 0 ) err = "unexpected end of file";
+    if ( err != nullptr ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not read compressed file: %s", err );
+        error( msg );
+    }
+    this->zs.next_in  += in_len;
+    this->zs.avail_in -= in_len;
+    this->frame_open = hint != 0;
+    return out_len;
+}
+
+//---------------------------------------
+// Element Scan
+//
+// Finds the top-level elements in text fed to it a piece at a time,
+// looking only at brackets, commas, strings and comments.  An element 
+// is whatever has more than blanks and comments between its separators,
+// as NodeIO::elem_next() skips empty ones.  The scan stops at the closing
+// ']', or at once if the text isn't a list.
+//---------------------------------------
+class ElemScan
+{
+public:
+    FILE *              out;                    // where IndexElems go
+    int64_t             cnt;                    // elements found
+    uint64_t            off;                    // text offset of the next byte fed
+    int64_t             line;                   // line of the next byte scanned
+    int                 depth;                  // brackets open
+    bool                in_str;
+    bool                in_esc;                 // after a '\' in a string
+    bool                in_comment;
+    bool                content;                // the current element isn't empty
+    bool                done;
+    IndexElem           elem;                   // where the current element starts
+
+    void                feed( const unsigned char * p, int n );
+};
+
+void ElemScan::feed( const unsigned char * p, int n )
+{
+    uint64_t off = this->off;
+    this->off += n;
+    for( int i = 0; i < n && !this->done; i++ )
+    {
+        char c = p[i];
+        if ( c == '\n' ) this->line++;
+        if ( this->in_comment ) {
+            this->in_comment = c != '\n';
+            continue;
+        }
+        if ( this->in_str ) {
+            if ( this->in_esc ) {
+                this->in_esc = false;
+            } else if ( c == '\\' ) {
+                this->in_esc = true;
+            } else if ( c == '"' ) {
+                this->in_str = false;
+            }
+            continue;
+        }
+        switch( c )
+        {
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+                continue;
+
+            case '#':
+                this->in_comment = true;
+                continue;
+
+            default:
+                break;
+        }
+
+        if ( this->depth == 0 ) {
+            this->done = c != '[';
+            this->depth = 1;
+            this->elem.off = off + i + 1;
+            this->elem.line = this->line;
+            this->content = false;
+            continue;
+        }
+        if ( this->depth == 1 && (c == ',' || c == ']') ) {
+            if ( this->content ) {
+                if ( fwrite( &this->elem, sizeof( this->elem ), 1, this->out ) != 1 ) error( "could not write index" );
+                this->cnt++;
+            }
+            this->done = c == ']';
+            this->elem.off = off + i + 1;
+            this->elem.line = this->line;
+            this->content = false;
+            continue;
+        }
+        this->content = true;
+        switch( c )
+        {
+            case '"':   this->in_str = true;    break;
+            case '[':
+            case '{':   this->depth++;          break;
+            case ']':
+            case '}':   this->depth--;          break;
+            default:                            break;
+        }
+    }
+}
+
+//---------------------------------------
+// Writing
+//
+// One pass over f.  For a gzipped f, inflate stops at every block
+// boundary (Z_BLOCK) and writes into a circular window, so the 32KB
+// before a new point is always at hand.  zstd and lz4 are decoded a 
+// call at a time, to catch the ends of frames.
+//---------------------------------------
+static void point_add( IndexPoint *& points, int64_t& cnt, int64_t& alloc, const IndexPoint& point )
+{
+    if ( cnt == alloc ) {
+        IndexPoint * new_points = new IndexPoint[alloc << 1];
+        memcpy( new_points, points, cnt * sizeof( IndexPoint ) );
+        delete[] points;
+        points = new_points;
+        alloc <<= 1;
+    }
+    points[cnt++] = point;
+}
+
+void nIndex::write( const char * file_path, long span )
+{
+    char msg[MSG_LEN];
+    int fd = ::open( file_path, O_RDONLY );
+    struct stat st;
+    if ( fd < 0 || fstat( fd, &st ) != 0 ) {
+        snprintf( msg, MSG_LEN, "could not open file %s for indexing, errno=%d", file_path, errno );
+        error( msg );
+    }
+    nCodec codec = NodeIO::codec( file_path );
+
+    char path[1024];
+    index_path( path, sizeof( path ), file_path );
+    FILE * out = fopen( path, "wb" );
+    FILE * windows = tmpfile();
+    if ( out == nullptr || windows == nullptr ) {
+        snprintf( msg, MSG_LEN, "could not open index %s.idx for writing, errno=%d", file_path, errno );
+        error( msg );
+    }
+    IndexHdr hdr;
+    memset( &hdr, 0, sizeof( hdr ) );
+    if ( fwrite( &hdr, sizeof( hdr ), 1, out ) != 1 ) error( "could not write index" );
+
+    ElemScan scan;
+    memset( &scan, 0, sizeof( scan ) );
+    scan.out  = out;
+    scan.line = 1;
+
+    int64_t      point_cnt   = 0;
+    int64_t      point_alloc = 64;
+    IndexPoint * points      = new IndexPoint[point_alloc];
+    if ( codec == CODEC_GZIP ) {
+        Stream *        stream = new Stream( fd, codec );
+        z_stream&       zs     = stream->zs;
+        unsigned char * window = new unsigned char[WINDOW_LEN];
+        uLong           packed_alloc = compressBound( WINDOW_LEN );
+        unsigned char * packed = new unsigned char[packed_alloc];
+        uint64_t        last   = 0;
+        memset( window, 0, WINDOW_LEN );
+        point_add( points, point_cnt, point_alloc, IndexPoint{ 0, 0, 0, 0, POINT_START, 0 } );
+        zs.avail_out = 0;
+        for( ;; )
+        {
+            if ( zs.avail_out == 0 ) {
+                zs.next_out  = window;
+                zs.avail_out = WINDOW_LEN;
+            }
+            if ( !stream->need( 1 ) ) {
+                snprintf( msg, MSG_LEN, "could not index %s: unexpected end of file", file_path );
+                error( msg );
+            }
+            unsigned char * from = zs.next_out;
+            int status = inflate( &zs, Z_BLOCK );
+            scan.feed( from, zs.next_out - from );
+            if ( status == Z_STREAM_END ) {
+                if ( !stream->member_next() ) break;
+                if ( scan.off - last >= uint64_t( span ) ) {
+                    point_add( points, point_cnt, point_alloc, IndexPoint{ scan.off, stream->in_off(), 0, 0, POINT_START, 0 } );
+                    last = scan.off;
+                }
+                continue;
+            }
+            if ( status != Z_OK ) {
+                snprintf( msg, MSG_LEN, "could not index %s: %s", file_path, (zs.msg != nullptr) ? zs.msg : "inflate failed" );
+                error( msg );
+            }
+            if ( (zs.data_type & 128) && !(zs.data_type & 64) && scan.off - last >= uint64_t( span ) ) {
+                //---------------------------------------
+                // Unroll the circular window into the dictionary order.
+                //---------------------------------------
+                int      wrap = WINDOW_LEN - zs.avail_out;
+                Bytef    dict[WINDOW_LEN];
+                memcpy( dict, window + wrap, WINDOW_LEN - wrap );
+                memcpy( dict + WINDOW_LEN - wrap, window, wrap );
+                uLong    packed_len = packed_alloc;
+                if ( compress2( packed, &packed_len, dict, WINDOW_LEN, 1 ) != Z_OK ) error( "could not deflate index window" );
+                uint64_t at = ftell( windows );
+                if ( fwrite( packed, 1, packed_len, windows ) != packed_len ) error( "could not write index" );
+                point_add( points, point_cnt, point_alloc, IndexPoint{ scan.off, stream->in_off(), at, uint32_t( packed_len ), POINT_BLOCK, uint16_t( zs.data_type & 7 ) } );
+                last = scan.off;
+            }
+        }
+        delete[] packed;
+        delete[] window;
+        delete stream;
+    } else if ( codec != CODEC_NONE ) {
+        Stream *        stream = new Stream( fd, codec );
+        unsigned char * text   = new unsigned char[IN_LEN];
+        uint64_t        last   = 0;
+        point_add( points, point_cnt, point_alloc, IndexPoint{ 0, 0, 0, 0, POINT_START, 0 } );
+        for( ;; )
+        {
+            int len = stream->frame_step( text, IN_LEN );
+            if ( stream->done ) break;
+            scan.feed( text, len );
+            if ( !stream->frame_open && scan.off - last >= uint64_t( span ) ) {
+                point_add( points, point_cnt, point_alloc, IndexPoint{ scan.off, stream->in_off(), 0, 0, POINT_START, 0 } );
+                last = scan.off;
+            }
+        }
+        delete[] text;
+        delete stream;
+    } else {
+        unsigned char * text = new unsigned char[IN_LEN];
+        for( ;; )
+        {
+            ssize_t len = ::read( fd, text, IN_LEN );
+            if ( len < 0 && errno == EINTR ) continue;
+            if ( len < 0 ) {
+                snprintf( msg, MSG_LEN, "could not read file %s, errno=%d", file_path, errno );
+                error( msg );
+            }
+            if ( len == 0 ) break;
+            scan.feed( text, len );
+        }
+        delete[] text;
+    }
+    close( fd );
+    dprintf( "index %s: %ld elements, %ld points\n", path, long( scan.cnt ), long( point_cnt ) );
+
+    //---------------------------------------
+    // Elements are in place; append the windows and the points, 
+    // then fill in the header.
+    //---------------------------------------
+    memcpy( hdr.magic, INDEX_MAGIC, sizeof( hdr.magic ) );
+    hdr.version   = INDEX_VERSION;
+    hdr.order     = INDEX_ORDER;
+    hdr.file_len  = st.st_size;
+    file_mtime( st, hdr.file_sec, hdr.file_nsec );
+    hdr.text_len  = scan.off;
+    hdr.span      = span;
+    hdr.codec     = codec;
+    hdr.elem_cnt  = scan.cnt;
+    hdr.elems     = sizeof( hdr );
+    hdr.windows   = hdr.elems + scan.cnt * sizeof( IndexElem );
+    rewind( windows );
+    char copy[IN_LEN];
+    for( size_t len; (len = fread( copy, 1, IN_LEN, windows )) != 0; )
+    {
+        if ( fwrite( copy, 1, len, out ) != len ) error( "could not write index" );
+    }
+    uint64_t pos = ftell( out );
+    uint64_t pad = 0;
+    hdr.points    = (pos + 7) & ~7ULL;
+    hdr.point_cnt = point_cnt;
+    hdr.len       = hdr.points + point_cnt * sizeof( IndexPoint );
+    if ( fwrite( &pad, 1, hdr.points - pos, out ) != hdr.points - pos ||
+         fwrite( points, sizeof( IndexPoint ), point_cnt, out ) != size_t( point_cnt ) ) error( "could not write index" );
+    rewind( out );
+    if ( fwrite( &hdr, sizeof( hdr ), 1, out ) != 1 || fclose( out ) != 0 ) error( "could not write index" );
+    fclose( windows );
+    delete[] points;
+}
+
+//---------------------------------------
+// Opening
+//---------------------------------------
+nIndex * nIndex::open( const char * file_path )
+{
+    char path[1024];
+    index_path( path, sizeof( path ), file_path );
+    int fd = ::open( path, O_RDONLY );
+    if ( fd < 0 ) return nullptr;
+
+    struct stat file_st;
+    struct stat st;
+    IndexHdr hdr;
+    int64_t  file_sec  = 0;
+    int64_t  file_nsec = 0;
+    bool     file_ok   = stat( file_path, &file_st ) == 0;
+    if ( file_ok ) file_mtime( file_st, file_sec, file_nsec );
+    if ( !file_ok || fstat( fd, &st ) != 0 || size_t( st.st_size ) < sizeof( hdr ) ||
+         pread( fd, &hdr, sizeof( hdr ), 0 ) != sizeof( hdr ) || memcmp( hdr.magic, INDEX_MAGIC, sizeof( hdr.magic ) ) != 0 ||
+         hdr.version != INDEX_VERSION || hdr.order != INDEX_ORDER || hdr.len != uint64_t( st.st_size ) || 
+         hdr.file_len != uint64_t( file_st.st_size ) || hdr.file_sec != file_sec || hdr.file_nsec != file_nsec ) {
+        dprintf( "index %s: missing or out of date\n", path );
+        close( fd );
+        return nullptr;
+    }
+
+    void * addr = mmap( nullptr, hdr.len, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if ( addr == MAP_FAILED ) {
+        char msg[MSG_LEN];
+        snprintf( msg, MSG_LEN, "could not map index %s.idx, errno=%d", file_path, errno );
+        error( msg );
+    }
+
+    nIndex * index = new nIndex;
+    index->addr    = static_cast<char *>( addr );
+    index->len     = hdr.len;
+    index->stream  = nullptr;
+    if ( hdr.codec != CODEC_NONE ) {
+        fd = ::open( file_path, O_RDONLY );
+        if ( fd < 0 ) {
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "could not open file %s for reading, errno=%d", file_path, errno );
+            error( msg );
+        }
+        index->stream = new Stream( fd, nCodec( hdr.codec ) );
+    }
+    return index;
+}
+
+nIndex::~nIndex()
+{
+    if ( this->stream != nullptr ) {
+        close( this->stream->fd );
+        delete this->stream;
+    }
+    munmap( this->addr, this->len );
+}
+
+//---------------------------------------
+// Elements
+//---------------------------------------
+long nIndex::elem_cnt( void )
+{
+    return reinterpret_cast<const IndexHdr *>( this->addr )->elem_cnt;
+}
+
+long nIndex::elem_off( long k )
+{
+    const IndexHdr * hdr = reinterpret_cast<const IndexHdr *>( this->addr );
+    dassert( k >= 0 && k < hdr->elem_cnt );
+    return reinterpret_cast<const IndexElem *>( this->addr + hdr->elems )[k].off;
+}
+
+int nIndex::elem_line( long k )
+{
+    const IndexHdr * hdr = reinterpret_cast<const IndexHdr *>( this->addr );
+    dassert( k >= 0 && k < hdr->elem_cnt );
+    return reinterpret_cast<const IndexElem *>( this->addr + hdr->elems )[k].line;
+}
+
+bool nIndex::compressed( void )
+{
+    return this->stream != nullptr;
+}
+
+//---------------------------------------
+// Reading
+//
+// seek() restarts decompression at the last point at or before off, 
+// primes inflate with the point's window if it has one, and reads up 
+// to off.
+//---------------------------------------
+void nIndex::seek( long off )
+{
+    const IndexHdr *   hdr    = reinterpret_cast<const IndexHdr *>( this->addr );
+    const IndexPoint * points = reinterpret_cast<const IndexPoint *>( this->addr + hdr->points );
+    dassert( this->stream != nullptr && off >= 0 && uint64_t( off ) <= hdr->text_len );
+    int64_t lo = 0;                                                             // points[0] is at 0
+    int64_t hi = hdr->point_cnt - 1;
+    while( lo < hi )
+    {
+        int64_t mid = (lo + hi + 1) >> 1;
+        if ( points[mid].text_off <= uint64_t( off ) ) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    const IndexPoint& point = points[lo];
+    Stream * stream = this->stream;
+    if ( point.kind == POINT_START ) {
+        stream->start( point.in_off, false );
+    } else {
+        stream->start( point.in_off - (point.bits ? 1 : 0), true );
+        if ( point.bits != 0 ) {
+            if ( !stream->need( 1 ) ) error( "compressed file is shorter than its index" );
+            int c = *stream->zs.next_in++;
+            stream->zs.avail_in--;
+            inflatePrime( &stream->zs, point.bits, c >> (8 - point.bits) );
+        }
+        Bytef dict[WINDOW_LEN];
+        uLong dict_len = WINDOW_LEN;
+        if ( uncompress( dict, &dict_len, reinterpret_cast<const Bytef *>( this->addr + hdr->windows + point.window ), point.window_len ) != Z_OK ||
+             dict_len != WINDOW_LEN || inflateSetDictionary( &stream->zs, dict, WINDOW_LEN ) != Z_OK ) error( "bad window in index" );
+    }
+    dprintf( "seek %ld: point %ld at %ld\n", off, long( lo ), long( point.text_off ) );
+
+    char skip[1 << 14];
+    for( uint64_t left = off - point.text_off; left != 0; )
+    {
+        int len = this->read( skip, (left < sizeof( skip )) ? left : sizeof( skip ) );
+        if ( len == 0 ) error( "compressed file is shorter than its index" );
+        left -= len;
+    }
+}
+
+int nIndex::read( char * buf, int len )
+{
+    Stream *  stream = this->stream;
+    if ( stream->codec != CODEC_GZIP ) {
+        int got = 0;
+        while( got < len && !stream->done )
+        {
+            got += stream->frame_step( reinterpret_cast<unsigned char *>( buf ) + got, len - got );
+        }
+        return got;
+    }
+
+    z_stream& zs     = stream->zs;
+    zs.next_out  = reinterpret_cast<Bytef *>( buf );
+    zs.avail_out = len;
+    while( zs.avail_out != 0 && !stream->done )
+    {
+        if ( !stream->need( 1 ) ) error( "could not read gzipped file: unexpected end of file" );
+        int status = inflate( &zs, Z_NO_FLUSH );
+        if ( status == Z_STREAM_END ) {
+            stream->done = !stream->member_next();
+        } else if ( status != Z_OK ) {
+            char msg[MSG_LEN];
+            snprintf( msg, MSG_LEN, "could not read gzipped file: %s", (zs.msg != nullptr) ? zs.msg : "inflate failed" );
+            error( msg );
+        }
+    }
+    return len - zs.avail_out;
+}
@@ -0,0 +1,722 @@
+// Copyright (c) 2014-2019 Robert A. Alfieri
+// 
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+// 
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+// 
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+// 
+
+// _bench_node.cpp - microbenchmarks for Hash, List and NodeIO
+//
+// Usage: _bench_node.exe [name]       runs all benchmarks or just the named one
+//        _bench_node.exe mem <file>  parses a file and reports memory used
+//        _bench_node.exe parse <file> parses a file repeatedly and reports MB/s
+//
+#include "Node.h"
+#include "Misc.h"
+#include "stdio.h"
+#include "string.h"
+#include "time.h"
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <thread>
+
+static double now_sec( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return double(ts.tv_sec) + double(ts.tv_nsec)*1e-9;
+}
+
+static volatile nInt sink;      // keeps results alive
+
+//-------------------------------------------
+// Reference: the original Hash::Impl::get(), with id, kind and 
+// value interleaved in one entry and plain linear probing.
+//-------------------------------------------
+class RefEntry
+{
+public:
+    int   id;
+    nKind kind;
+    union
+    {
+        nInt  i;
+        nFlt  f;
+    } u;
+};
+
+class RefHash
+{
+public:
+    int        mask;
+    RefEntry * entries;
+
+    RefHash( int id_cnt )
+    {
+        int cnt = 4;
+        while( id_cnt*4 > cnt*3 ) cnt <<= 1;    // same size as Hash, for a fair comparison
+        mask = cnt-1;
+        entries = new RefEntry[cnt];
+        for( int i = 0; i < cnt; i++ ) entries[i].id = -1;
+    }
+
+    ~RefHash()
+    {
+        delete[] entries;
+    }
+
+    void set( int id, nInt v )
+    {
+        int i = id & mask;
+        while( entries[i].id != -1 ) i = (i+1) & mask;
+        entries[i].id = id;
+        entries[i].kind = INT;
+        entries[i].u.i = v;
+    }
+
+    __attribute__((noinline)) nInt get( int id )
+    {
+        int i = id & mask;
+        RefEntry * e = &entries[i];
+        for( int j = 0; j <= mask; j++ )
+        {
+            if ( e->id == id ) return e->u.i;
+            if ( e->id == -1 ) break;
+            if ( i == mask ) {
+                i = 0;
+                e = &entries[0];
+            } else {
+                i++;
+                e++;
+            }
+        }
+        return 0;
+    }
+};
+
+//-------------------------------------------
+// Hash lookup throughput for tables of various sizes, hits and misses.
+// Ids are scattered like interned ids from a busy process.
+//-------------------------------------------
+static void bench_hash_get( void )
+{
+    const int LOOKUP_CNT = 20000000;
+    const int SIZES[]    = { 8, 64, 1024, 65536 };
+
+    printf( "hash_get:\n" );
+    for( int size : SIZES )
+    {
+        int * ids = new int[size];
+        Hash * h = new Hash;
+        RefHash * r = new RefHash( size );
+        for( int k = 0; k < size; k++ )
+        {
+            ids[k] = rand_n( 1 << 20 );
+            while( h->exists( ids[k] ) ) ids[k] = rand_n( 1 << 20 );
+            h->i( ids[k], k );
+            r->set( ids[k], k );
+        }
+        int * order = new int[0x10000];
+        int * absent = new int[0x10000];
+        for( int k = 0; k <= 0xffff; k++ ) 
+        {
+            order[k] = ids[rand_n( size )];
+            absent[k] = rand_n( 1 << 20 );
+            while( h->exists( absent[k] ) ) absent[k] = rand_n( 1 << 20 );
+        }
+
+        nInt sum = 0;
+        double t0 = now_sec();
+        for( int n = 0; n < LOOKUP_CNT; n++ ) sum += r->get( order[n & 0xffff] );
+        double t1 = now_sec();
+        for( int n = 0; n < LOOKUP_CNT; n++ ) sum += h->i( order[n & 0xffff] );
+        double t2 = now_sec();
+        for( int n = 0; n < LOOKUP_CNT; n++ ) sum += r->get( absent[n & 0xffff] );
+        double t3 = now_sec();
+        for( int n = 0; n < LOOKUP_CNT; n++ ) sum += h->exists( absent[n & 0xffff] );
+        double t4 = now_sec();
+        sink = sum;
+
+        printf( "    size=%-6d hits: original=%6.1f Hash=%6.1f   misses: original=%6.1f Hash=%6.1f  (Mlookups/s)\n", 
+                size, LOOKUP_CNT/(t1-t0)/1e6, LOOKUP_CNT/(t2-t1)/1e6, LOOKUP_CNT/(t3-t2)/1e6, LOOKUP_CNT/(t4-t3)/1e6 );
+        delete[] absent;
+        delete[] order;
+        delete r;
+        delete h;
+        delete[] ids;
+    }
+}
+
+//-------------------------------------------
+// Reading every property of many records with the same layout:
+// plain hashes looked up by id vs. shaped hashes looked up by nProp.
+//-------------------------------------------
+static void bench_shape_get( void )
+{
+    const int REC_CNT  = 1000000;
+    const int PROP_CNT = 8;
+
+    printf( "shape_get:\n" );
+    for( int shaped = 0; shaped < 2; shaped++ )
+    {
+        Hash ** recs = new Hash*[REC_CNT];
+        for( int r = 0; r < REC_CNT; r++ )
+        {
+            recs[r] = new Hash( shaped );
+            for( int k = 0; k < PROP_CNT; k++ ) recs[r]->i( Hash::id_kind + k, r+k );
+        }
+        nProp props[PROP_CNT];
+        for( int k = 0; k < PROP_CNT; k++ ) props[k] = nProp( Hash::id_kind + k );
+
+        nInt sum = 0;
+        double t0 = now_sec();
+        for( int r = 0; r < REC_CNT; r++ )
+        {
+            for( int k = 0; k < PROP_CNT; k++ ) 
+            {
+                sum += shaped ? recs[r]->i( props[k] ) : recs[r]->i( Hash::id_kind + k );
+            }
+        }
+        double t1 = now_sec();
+        sink = sum;
+        printf( "    %-8s %6.1f Mlookups/s\n", shaped ? "shaped" : "plain", double(REC_CNT)*PROP_CNT/(t1-t0)/1e6 );
+
+        for( int r = 0; r < REC_CNT; r++ ) delete recs[r];
+        delete[] recs;
+    }
+}
+
+//-------------------------------------------
+// Using a List as a queue: fill with 1M entries then shift them all off,
+// and a steady-state queue that pushes one and shifts one.  
+// The original memmove-on-shift behavior is shown on a smaller queue, 
+// since at 1M entries it would take hours.
+//-------------------------------------------
+static void bench_list_queue( void )
+{
+    const int QUEUE_CNT = 1000000;
+    const int REF_CNT   = 50000;
+
+    printf( "list_queue:\n" );
+    nInt sum = 0;
+    List * l = new List;
+    double t0 = now_sec();
+    for( int n = 0; n < QUEUE_CNT; n++ ) l->pushi( n );
+    double t1 = now_sec();
+    while( l->length() != 0 ) sum += l->shifti();
+    double t2 = now_sec();
+    for( int n = 0; n < 1000; n++ ) l->pushi( n );
+    double t3 = now_sec();
+    for( int n = 0; n < QUEUE_CNT; n++ ) 
+    {
+        l->pushi( n );
+        sum += l->shifti();
+    }
+    double t4 = now_sec();
+    delete l;
+
+    nVal * ref = new nVal[REF_CNT];
+    for( int n = 0; n < REF_CNT; n++ ) ref[n].i( n );
+    double t5 = now_sec();
+    for( int cnt = REF_CNT; cnt > 0; cnt-- ) 
+    {
+        sum += ref[0].i();
+        memmove( &ref[0], &ref[1], (cnt-1) * sizeof( nVal ) );
+    }
+    double t6 = now_sec();
+    sink = sum;
+    delete[] ref;
+
+    printf( "    fill %d:         %6.1f ns/push\n", QUEUE_CNT, (t1-t0)/QUEUE_CNT*1e9 );
+    printf( "    drain %d:        %6.1f ns/shift\n", QUEUE_CNT, (t2-t1)/QUEUE_CNT*1e9 );
+    printf( "    steady queue of 1000: %6.1f ns/push+shift\n", (t4-t3)/QUEUE_CNT*1e9 );
+    printf( "    original drain %d: %6.1f ns/shift\n", REF_CNT, (t6-t5)/REF_CNT*1e9 );
+}
+
+//-------------------------------------------
+// Summing 1M floats: a list with one STR at the end (so it stays unpacked) 
+// read through f(i), vs. a packed list read through f(i) and through fp().
+//-------------------------------------------
+static void bench_list_sum( void )
+{
+    const int FLT_CNT  = 1000000;
+    const int PASS_CNT = 20;
+
+    printf( "list_sum:\n" );
+    List * tagged = new List;
+    List * packed = new List;
+    for( int n = 0; n < FLT_CNT; n++ ) 
+    {
+        tagged->pushf( n );
+        packed->pushf( n );
+    }
+    tagged->pushs( "end" );
+
+    nFlt sum = 0.0;
+    double t0 = now_sec();
+    for( int p = 0; p < PASS_CNT; p++ ) for( int n = 0; n < FLT_CNT; n++ ) sum += tagged->f( n );
+    double t1 = now_sec();
+    for( int p = 0; p < PASS_CNT; p++ ) for( int n = 0; n < FLT_CNT; n++ ) sum += packed->f( n );
+    double t2 = now_sec();
+    for( int p = 0; p < PASS_CNT; p++ ) 
+    {
+        const nFlt * flts = packed->fp();
+        for( int n = 0; n < FLT_CNT; n++ ) sum += flts[n];
+    }
+    double t3 = now_sec();
+    sink = nInt( sum );
+
+    nStats st_tagged;
+    nStats st_packed;
+    tagged->stats( st_tagged );
+    packed->stats( st_packed );
+    printf( "    unpacked f(i): %6.2f ns/entry  %ld bytes\n", (t1-t0)/PASS_CNT/FLT_CNT*1e9, st_tagged.list_bytes );
+    printf( "    packed f(i):   %6.2f ns/entry  %ld bytes\n", (t2-t1)/PASS_CNT/FLT_CNT*1e9, st_packed.list_bytes );
+    printf( "    packed fp():   %6.2f ns/entry\n", (t3-t2)/PASS_CNT/FLT_CNT*1e9 );
+    delete tagged;
+    delete packed;
+}
+
+//-------------------------------------------
+// Memory used by a parsed file, as counted by nStats and as seen by the OS.
+// Build with EXTRA_CFLAGS=-DNODE_NANBOX to compare 8-byte nVals.
+//-------------------------------------------
+static long max_rss_kb( void )
+{
+    struct rusage ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_maxrss;
+}
+
+static void bench_mem( const char * file_path )
+{
+    printf( "mem: sizeof(nVal)=%d sizeof(Hash)=%d sizeof(List)=%d\n", int(sizeof(nVal)), int(sizeof(Hash)), int(sizeof(List)) );
+    printf( "     %s is %s\n", file_path, NodeIO( file_path ).mapped() ? "mapped" : "read through zlib" );
+    static const char * config_names[] = { "heap      ", "arena     ", "arena+pool", "+dedupe   ", "in place  " };
+    for( int config = 0; config < 5; config++ )
+    {
+        bool use_arena    = config >= 1;
+        bool use_pool     = config == 2 || config == 3;
+        bool use_dedupe   = config == 3;
+        bool use_in_place = config == 4;        // uncompressed files only
+        nArena * arena = use_arena ? new nArena : nullptr;
+        long rss0 = max_rss_kb();
+        double t0 = now_sec();
+        NodeIO * nodeio = new NodeIO( file_path );
+        nodeio->shaped_set( true );
+        nodeio->arena_set( arena );
+        nodeio->str_pool_set( use_pool );
+        nodeio->dedupe_set( use_dedupe );
+        nodeio->str_in_place_set( use_in_place );
+        List * list = nodeio->list_parse();
+        double t1 = now_sec();
+        long rss1 = max_rss_kb();
+
+        nStats st;
+        list->stats( st );
+        nodeio->stats( st );
+        delete nodeio;
+        printf( "    %s: hash bytes: %ld  list bytes: %ld  string bytes: %ld", 
+                config_names[config], st.hash_bytes, st.list_bytes, st.str_bytes );
+        if ( use_dedupe ) printf( "  deduped: %ld of %ld nodes", st.parse_shared_cnt, st.parse_node_cnt );
+        printf( "\n" );
+        printf( "                max rss grew by %ld KB, parse took %.3f s", rss1 - rss0, t1-t0 );
+        if ( use_arena ) {
+            printf( ", arena holds %ld KB", arena->bytes() >> 10 );
+            double t2 = now_sec();
+            delete arena;
+            printf( ", teardown took %.3f s", now_sec()-t2 );
+        }
+        printf( "\n" );
+    }
+
+    //-------------------------------------------
+    // Streaming, one top-level element at a time, keeps nothing.
+    //-------------------------------------------
+    nArena * arena = new nArena;
+    long rss0 = max_rss_kb();
+    double t0 = now_sec();
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->shaped_set( true );
+    nodeio->arena_set( arena );
+    nodeio->str_pool_set( true );
+    nVal elem;
+    long elem_cnt = 0;
+    for( ;; )
+    {
+        nArena::Mark m = arena->mark();
+        if ( !nodeio->elem_next( elem ) ) break;
+        elem_cnt++;
+        arena->release( m );
+    }
+    delete nodeio;
+    printf( "    streaming : %ld elements, max rss grew by %ld KB, parse took %.3f s\n", elem_cnt, max_rss_kb() - rss0, now_sec()-t0 );
+    delete arena;
+}
+
+//-------------------------------------------
+// Parse throughput, best of several passes, into an arena so that
+// allocation stays cheap and the scanner dominates.  Compare builds with
+// EXTRA_CFLAGS=-DNODEIO_SCALAR (per-char loops) and AVX2=1.  Sizes are of 
+// the file as stored, so gzipped input counts compressed bytes.
+//-------------------------------------------
+static void bench_parse( const char * file_path )
+{
+    const int PASS_CNT = 5;
+
+    struct stat st;
+    if ( stat( file_path, &st ) != 0 ) error( "could not stat file" );
+    double mb = double( st.st_size ) / double( 1 << 20 );
+    printf( "parse: %s is %.1f MB, %s, scanner is %s\n", file_path, mb, 
+            NodeIO( file_path ).mapped() ? "mapped" : "read through zlib", NodeIO::scanner() );
+    double best = 1e30;
+    for( int pass = 0; pass < PASS_CNT; pass++ )
+    {
+        double t0 = now_sec();
+        NodeIO * nodeio = new NodeIO( file_path );
+        sink = nodeio->token_cnt();
+        delete nodeio;
+        double t = now_sec() - t0;
+        if ( t < best ) best = t;
+    }
+    printf( "    scan only       : %7.1f MB/s\n", mb / best );
+    const char * labels[] = { "strings copied  ", "strings in place", "all threads     " };
+    for( int mode = 0; mode < 3; mode++ )
+    {
+        double best = 1e30;
+        for( int pass = 0; pass < PASS_CNT; pass++ )
+        {
+            nArena * arena = new nArena;
+            double t0 = now_sec();
+            NodeIO * nodeio = new NodeIO( file_path );
+            nodeio->arena_set( arena );
+            nodeio->str_in_place_set( mode == 1 );
+            if ( mode == 2 ) nodeio->threads_set( 0 );
+            sink = nodeio->list_parse()->length();
+            delete nodeio;
+            double t = now_sec() - t0;
+            if ( t < best ) best = t;
+            delete arena;
+        }
+        printf( "    %s: %7.1f MB/s\n", labels[mode], mb / best );
+    }
+}
+
+//---------------------------------------
+// bench_image: text parse vs. opening a node image of the same tree,
+// both alone and followed by a walk over every node (stats).
+//---------------------------------------
+static void bench_image( const char * file_path )
+{
+    const int    PASS_CNT = 5;
+    const char * img_path = "_bench_node.img";
+
+    nArena * arena = new nArena;
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    List * list = nodeio->list_parse();
+    delete nodeio;
+    double t0 = now_sec();
+    nImage::write( img_path, list );
+    double write_t = now_sec() - t0;
+    delete arena;
+
+    struct stat st;
+    if ( stat( img_path, &st ) != 0 ) error( "could not stat image" );
+    printf( "image: %s written as %.1f MB in %.3f s\n", file_path, double( st.st_size ) / double( 1 << 20 ), write_t );
+    for( int image = 0; image < 2; image++ )
+    {
+        for( int walk = 0; walk < 2; walk++ )
+        {
+            double best = 1e30;
+            for( int pass = 0; pass < PASS_CNT; pass++ )
+            {
+                arena = new nArena;
+                t0 = now_sec();
+                nodeio = new NodeIO( image ? img_path : file_path );
+                nodeio->arena_set( arena );
+                list = nodeio->list_parse();
+                delete nodeio;
+                if ( walk ) {
+                    nStats ns;
+                    list->stats( ns );
+                    sink = ns.hash_prop_cnt;
+                }
+                double t = now_sec() - t0;
+                if ( t < best ) best = t;
+                delete arena;
+            }
+            printf( "    %s%s: %9.3f ms\n", image ? "image open" : "text parse", walk ? " + walk" : "       ", best * 1000.0 );
+        }
+    }
+    remove( img_path );
+}
+
+//---------------------------------------
+// bench_write: NodeIOWriter at a few gzip levels, in MB/s of text, 
+// next to the reader.  The output is left in _bench_node.out.
+//---------------------------------------
+static void bench_write( const char * file_path )
+{
+    const int    PASS_CNT = 3;
+    const char * out_path = "_bench_node.out";
+
+    nArena * arena = new nArena;
+    double t0 = now_sec();
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    List * list = nodeio->list_parse();
+    delete nodeio;
+    double read_t = now_sec() - t0;
+    struct stat st;
+    if ( stat( file_path, &st ) != 0 ) error( "could not stat file" );
+    double read_mb = double( st.st_size ) / double( 1 << 20 );
+
+    double mb = 0.0;
+    const int levels[] = { 0, 1, 6 };
+    for( int level : levels )
+    {
+        double best = 1e30;
+        for( int pass = 0; pass < PASS_CNT; pass++ )
+        {
+            t0 = now_sec();
+            NodeIOWriter * writer = new NodeIOWriter( out_path, level );
+            writer->list_write( list );
+            mb = double( writer->text_len() ) / double( 1 << 20 );
+            delete writer;
+            double t = now_sec() - t0;
+            if ( t < best ) best = t;
+        }
+        if ( stat( out_path, &st ) != 0 ) error( "could not stat output" );
+        if ( level == 0 ) printf( "write: %s is %.1f MB as text (read at %.1f MB/s)\n", file_path, mb, read_mb / read_t );
+        printf( "    level %d         : %7.1f MB/s, %6.1f MB\n", level, mb / best, double( st.st_size ) / double( 1 << 20 ) );
+    }
+    delete arena;
+
+    double best = 1e30;
+    for( int pass = 0; pass < PASS_CNT; pass++ )
+    {
+        t0 = now_sec();
+        NodeIOWriter * writer = new NodeIOWriter( out_path );
+        nodeio = new NodeIO( file_path );
+        nodeio->events_parse( *writer );
+        delete nodeio;
+        delete writer;
+        double t = now_sec() - t0;
+        if ( t < best ) best = t;
+    }
+    printf( "    copy via events : %7.1f MB/s\n", mb / best );
+}
+
+//---------------------------------------
+// bench_codecs: writes the file with each codec this build has, then
+// times scanning it (token_cnt(), so mostly decompression) and parsing
+// it back.  Rates are MB/s of text.  The output is left
+// in _bench_node.out.
+//---------------------------------------
+static void bench_codecs( const char * file_path )
+{
+    const char * out_path = "_bench_node.out";
+    struct Run
+    {
+        const char * name;
+        nCodec       codec;
+        int          level;
+        int          threads;
+    };
+    const Run runs[] = { { "none",         CODEC_NONE, 0, 1 },
+                         { "gzip -1",      CODEC_GZIP, 1, 1 },
+                         { "gzip -6",      CODEC_GZIP, 6, 1 },
+                         { "zstd -1",      CODEC_ZSTD, 1, 1 },
+                         { "zstd -3",      CODEC_ZSTD, 3, 1 },
+                         { "zstd -3 -T0",  CODEC_ZSTD, 3, 0 },
+                         { "zstd -19 -T0", CODEC_ZSTD, 19, 0 },
+                         { "lz4 -1",       CODEC_LZ4,  1, 1 },
+                         { "lz4 -9",       CODEC_LZ4,  9, 1 } };
+
+    nArena * arena = new nArena;
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    List * list = nodeio->list_parse();
+    delete nodeio;
+
+    printf( "codecs: %s\n", file_path );
+    printf( "                   write MB/s      MB    scan MB/s  parse MB/s\n" );
+    for( const Run& run : runs )
+    {
+        if ( !NodeIO::codec_built( run.codec ) ) continue;
+        double t0 = now_sec();
+        NodeIOWriter * writer = new NodeIOWriter( out_path, run.level, run.codec );
+        writer->threads_set( run.threads );
+        writer->list_write( list );
+        double mb = double( writer->text_len() ) / double( 1 << 20 );
+        delete writer;
+        double write_t = now_sec() - t0;
+
+        t0 = now_sec();
+        nodeio = new NodeIO( out_path );
+        nodeio->token_cnt();
+        delete nodeio;
+        double scan_t = now_sec() - t0;
+
+        nArena * read_arena = new nArena;
+        t0 = now_sec();
+        nodeio = new NodeIO( out_path );
+        nodeio->arena_set( read_arena );
+        nodeio->list_parse();
+        delete nodeio;
+        double read_t = now_sec() - t0;
+        delete read_arena;
+
+        struct stat st;
+        if ( stat( out_path, &st ) != 0 ) error( "could not stat output" );
+        printf( "    %-12s : %9.1f %7.1f %9.1f %11.1f\n", run.name, mb / write_t, double( st.st_size ) / double( 1 << 20 ), mb / scan_t, mb / read_t );
+    }
+    delete arena;
+}
+
+//---------------------------------------
+// bench_index: builds file.idx (which is left there), then compares 
+// jumping to random elements of the top-level list through it with 
+// reading up to the last element.
+//---------------------------------------
+static void bench_index( const char * file_path )
+{
+    const int SEEK_CNT = 100;
+
+    double t0 = now_sec();
+    nIndex::write( file_path );
+    double write_t = now_sec() - t0;
+    char idx_path[1024];
+    snprintf( idx_path, sizeof( idx_path ), "%s.idx", file_path );
+    struct stat st;
+    if ( stat( idx_path, &st ) != 0 ) error( "could not stat index" );
+    printf( "index: built in %.3f sec, %.1f MB\n", write_t, double( st.st_size ) / double( 1 << 20 ) );
+
+    nArena * arena = new nArena;
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    long cnt = nodeio->elem_cnt();
+    if ( cnt <= 0 ) error( "file has no top-level list elements to jump to" );
+    nVal v;
+    nArena::Mark mark = arena->mark();
+    t0 = now_sec();
+    while( nodeio->elem_next( v ) ) arena->release( mark );
+    double seq_t = now_sec() - t0;
+    delete nodeio;
+
+    srand( 1 );
+    t0 = now_sec();
+    for( int i = 0; i < SEEK_CNT; i++ )
+    {
+        nodeio = new NodeIO( file_path );
+        nodeio->arena_set( arena );
+        nodeio->elem_seek( long( double( rand() ) / RAND_MAX * (cnt-1) ) );
+        if ( !nodeio->elem_next( v ) ) error( "seek found no element" );
+        delete nodeio;
+    }
+    double seek_t = (now_sec() - t0) / SEEK_CNT;
+    delete arena;
+    printf( "    %ld elements\n", cnt );
+    printf( "    read through to the last : %9.3f ms\n", seq_t * 1000.0 );
+    printf( "    open, jump, parse one    : %9.3f ms\n", seek_t * 1000.0 );
+}
+
+//---------------------------------------
+// bench_gunzip: writes the file gzipped in independent members, then 
+// scans it with one thread inflating and with all cores.  Needs as many
+// cores as possible to show anything.
+//---------------------------------------
+static void bench_gunzip( const char * file_path )
+{
+    const char * out_path = "_bench_node.out.gz";
+    const int    PASS_CNT = 3;
+
+    nArena * arena = new nArena;
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    List * list = nodeio->list_parse();
+    delete nodeio;
+    NodeIOWriter * writer = new NodeIOWriter( out_path, 6, CODEC_GZIP );
+    writer->list_write( list );
+    double mb = double( writer->text_len() ) / double( 1 << 20 );
+    delete writer;
+    delete arena;
+
+    printf( "gunzip: %s, %u cores\n", file_path, std::thread::hardware_concurrency() );
+    for( int threads = 1; threads >= 0; threads-- )
+    {
+        double best = 1e30;
+        for( int pass = 0; pass < PASS_CNT; pass++ )
+        {
+            double t0 = now_sec();
+            nodeio = new NodeIO( out_path );
+            nodeio->threads_set( threads );
+            sink = nodeio->token_cnt();
+            delete nodeio;
+            double t = now_sec() - t0;
+            if ( t < best ) best = t;
+        }
+        printf( "    scan, %s : %7.1f MB/s\n", (threads == 1) ? "1 thread  " : "all cores ", mb / best );
+    }
+    remove( out_path );
+}
+
+int main( int argc, const char * argv[] )
+{
+    const char * name = (argc > 1) ? argv[1] : "";
+    if ( strcmp( name, "mem" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe mem <file>" );
+        bench_mem( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "image" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe image <file>" );
+        bench_image( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "write" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe write <file>" );
+        bench_write( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "codecs" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe codecs <file>" );
+        bench_codecs( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "index" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe index <file>" );
+        bench_index( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "gunzip" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe gunzip <file>" );
+        bench_gunzip( argv[2] );
+        return 0;
+    }
+    if ( strcmp( name, "parse" ) == 0 ) {
+        if ( argc < 3 ) error( "usage: _bench_node.exe parse <file>" );
+        bench_parse( argv[2] );
+        return 0;
+    }
+    if ( !*name || strcmp( name, "hash_get" ) == 0 ) bench_hash_get();
+    if ( !*name || strcmp( name, "shape_get" ) == 0 ) bench_shape_get();
+    if ( !*name || strcmp( name, "list_queue" ) == 0 ) bench_list_queue();
+    if ( !*name || strcmp( name, "list_sum" ) == 0 ) bench_list_sum();
+    return 0;
+}
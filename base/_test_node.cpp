@@ -21,10 +21,220 @@
 #include "Hash.h"
 #include "List.h"
 #include "stdio.h"
+#include "string.h"
 #include "assert.h"
+#include "Misc.h"
+#include <thread>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "zlib.h"
+
+//-------------------------------------------
+// Streaming: writes events out as compact text, optionally stopping at
+// the first INT.
+//-------------------------------------------
+class EventText : public NodeIOEvents
+{
+public:
+    std::string text;
+    bool        stop_at_int = false;
+
+    bool list_begin( void )     { text += "["; return true; }
+    bool list_end( void )       { text += "]"; return true; }
+    bool hash_begin( void )     { text += "{"; return true; }
+    bool hash_end( void )       { text += "}"; return true; }
+    bool key( int id )          { text += std::string( Hash::id_to_str( id ) ) + ":"; return true; }
+    bool i( nInt v )            { text += std::to_string( v ) + " "; return !stop_at_int; }
+    bool f( nFlt v )            { text += std::to_string( v ) + " "; return true; }
+    bool s( nStr v )            { text += std::string( v ) + " "; return true; }
+};
+
+//-------------------------------------------
+// Images: a tree as text with hash properties sorted by name, so that
+// trees compare the same whatever their ids and table layout.
+//-------------------------------------------
+static std::string tree_text( nKind kind, Hash * h, List * l, int k )
+{
+    switch( kind )
+    {
+        case INT:   return std::to_string( h ? h->i( k ) : l->i( k ) ) + " ";
+        case FLT:   return std::to_string( h ? h->f( k ) : l->f( k ) ) + " ";
+        case STR:   return std::string( "'" ) + (h ? h->s( k ) : l->s( k )) + "' ";
+        case HASH:
+        {
+            Hash * hh = h ? h->hp( k ) : l->hp( k );
+            std::vector<std::string> props;
+            int hdl;
+            for( int id = hh->id_first( hdl ); id >= 0; id = hh->id_next( hdl ) )
+            {
+                props.push_back( std::string( Hash::id_to_str( id ) ) + ":" + tree_text( hh->kind( id ), hh, nullptr, id ) );
+            }
+            std::sort( props.begin(), props.end() );
+            std::string text = "{";
+            for( auto& prop : props ) text += prop;
+            return text + "} ";
+        }
+        case LIST:
+        {
+            List * ll = h ? h->lp( k ) : l->lp( k );
+            std::string text = "[";
+            for( int i = 0; i < ll->length(); i++ ) text += tree_text( ll->kind( i ), nullptr, ll, i );
+            return text + "] ";
+        }
+        default:    return "undef ";
+    }
+}
+
+static std::string tree_text( List * l )
+{
+    List root;
+    root.pushlp( l );
+    std::string text = tree_text( LIST, nullptr, &root, 0 );
+    root.poplp();
+    return text;
+}
+
+//-------------------------------------------
+// Concurrent interning: each thread interns the same strings 
+// in a different order and records the ids it got back.
+//-------------------------------------------
+const int INTERN_THREAD_CNT = 8;
+const int INTERN_STR_CNT    = 20000;
+
+static void intern_thread( int t, int * ids )
+{
+    char name[32];
+    for( int k = 0; k < INTERN_STR_CNT; k++ )
+    {
+        int n = (k * 7919 + t * 104729) % INTERN_STR_CNT;   // different order per thread
+        sprintf( name, "mt%d", n );
+        ids[n] = Hash::str_to_id( name );
+    }
+}
+
+//-------------------------------------------
+// _test_node.exe <file> [options]: parse a file or map an image and print occupancy stats
+//-------------------------------------------
+static int file_stats( const char * file_path, int opt_cnt, const char * opts[] )
+{
+    //-------------------------------------------
+    // Options are any of: shaped dedupe threads
+    //-------------------------------------------
+    nArena * arena = new nArena;
+    NodeIO * nodeio = new NodeIO( file_path );
+    nodeio->arena_set( arena );
+    for( int i = 0; i < opt_cnt; i++ )
+    {
+        if ( strcmp( opts[i], "shaped" ) == 0 ) {
+            nodeio->shaped_set( true );
+        } else if ( strcmp( opts[i], "dedupe" ) == 0 ) {
+            nodeio->dedupe_set( true );
+        } else if ( strcmp( opts[i], "threads" ) == 0 ) {
+            nodeio->threads_set( 0 );
+        } else {
+            char msg[256];
+            snprintf( msg, sizeof( msg ), "unknown option %s", opts[i] );
+            error( msg );
+        }
+    }
+    List * list = nodeio->list_parse();
+
+    nStats st;
+    list->stats( st );
+    nodeio->stats( st );
+    delete nodeio;
+    st.print( file_path );
+    printf( "    hash resizes: %ld\n", Hash::resize_cnt() );
+    printf( "    list resizes: %ld\n", List::resize_cnt() );
+    delete arena;
+    return 0;
+}
 
 int main( int argc, const char * argv[] )
 {
+    if ( argc > 1 ) return file_stats( argv[1], argc-2, &argv[2] );
+
+    //-------------------------------------------
+    // PROPERTY IDS
+    //-------------------------------------------
+    assert( Hash::str_to_id( "line" ) == Hash::id_line );      // well-known ids are pre-seeded
+    assert( Hash::str_to_id( "d" ) == Hash::id_d );
+    assert( strcmp( Hash::id_to_str( Hash::id_kind ), "kind" ) == 0 );
+
+    char name[32];
+    for( int n = 0; n < 10000; n++ )
+    {
+        sprintf( name, "prop%d", n );
+        int id = Hash::str_to_id( name );
+        assert( strcmp( Hash::id_to_str( id ), name ) == 0 );
+        assert( Hash::str_to_id( name ) == id );
+    }
+    assert( Hash::str_to_id( "prop0" ) + 9999 == Hash::str_to_id( "prop9999" ) );
+
+    int * mt_ids = new int[INTERN_THREAD_CNT*INTERN_STR_CNT];
+    std::thread * threads[INTERN_THREAD_CNT];
+    for( int t = 0; t < INTERN_THREAD_CNT; t++ )
+    {
+        threads[t] = new std::thread( intern_thread, t, &mt_ids[t*INTERN_STR_CNT] );
+    }
+    for( int t = 0; t < INTERN_THREAD_CNT; t++ )
+    {
+        threads[t]->join();
+        delete threads[t];
+    }
+    bool * id_seen = new bool[Hash::str_to_id( "mt_last" )+1]();
+    for( int n = 0; n < INTERN_STR_CNT; n++ )
+    {
+        int id = mt_ids[n];
+        for( int t = 1; t < INTERN_THREAD_CNT; t++ )
+        {
+            assert( mt_ids[t*INTERN_STR_CNT + n] == id );       // same id in every thread
+        }
+        assert( !id_seen[id] );                                 // unique
+        id_seen[id] = true;
+        sprintf( name, "mt%d", n );
+        assert( strcmp( Hash::id_to_str( id ), name ) == 0 );   // stable
+        assert( Hash::str_to_id( name ) == id );
+    }
+    delete[] id_seen;
+    delete[] mt_ids;
+
+    //-------------------------------------------
+    // VALUES - same results whether or not built with NODE_NANBOX
+    //-------------------------------------------
+    nVal v;
+    v.i( -(1L << 47) );
+    assert( v.kind() == INT && v.i() == -(1L << 47) );
+    v.i( (1L << 47) - 1 );
+    assert( v.kind() == INT && v.i() == (1L << 47) - 1 );
+    v.f( -0.0 / 0.0 );
+    assert( v.kind() == FLT && v.f() != v.f() );
+    v.f( -1.5 );
+    assert( v.kind() == FLT && v.f() == -1.5 );
+    v.s( name );
+    assert( v.kind() == STR && v.s() == name );
+    v.undef();
+    assert( v.kind() == UNDEF );
+
+    //-------------------------------------------
+    // STRING POOL - equal strings share one pointer, and pooling doesn't
+    // use up property ids
+    //-------------------------------------------
+    char gray[8];
+    strcpy( gray, "gray" );
+    nStr pooled_gray = Hash::str_pooled( "gray" );
+    assert( Hash::str_pooled( gray ) == pooled_gray && pooled_gray != gray && strcmp( pooled_gray, "gray" ) == 0 );
+    int pool_id = Hash::str_to_id( "pool id 1" );
+    assert( strcmp( Hash::str_pooled( "pool value only" ), "pool value only" ) == 0 );
+    assert( Hash::str_to_id( "pool id 2" ) == pool_id + 1 );
+    Hash * hp1 = new Hash;
+    hp1->sp( Hash::id_color, pooled_gray );
+    assert( hp1->s( Hash::id_color ) == pooled_gray );
+    delete hp1;
+
     //-------------------------------------------
     // HASH
     //-------------------------------------------
@@ -52,6 +262,96 @@ int main( int argc, const char * argv[] )
     }
     h1->print( "many fields" );
 
+    //-------------------------------------------
+    // SMALL HASH - stays inline up to 8 properties, then moves to a table
+    //-------------------------------------------
+    Hash * h3 = new Hash;
+    for( int id = 100; id < 108; id++ ) h3->i( id, id*10 );
+    h3->remove( 103 );
+    assert( !h3->exists( 103 ) && h3->i( 104 ) == 1040 );
+    int hdl3;
+    int expect_id = 100;
+    for( int id = h3->id_first( hdl3 ); id >= 0; id = h3->id_next( hdl3 ) )
+    {
+        assert( id == expect_id );                              // inline keeps insertion order
+        expect_id += (expect_id == 102) ? 2 : 1;
+    }
+    for( int id = 200; id < 210; id++ ) h3->f( id, id );       // overflow into table
+    for( int id = 100; id < 108; id++ ) assert( h3->exists( id ) == (id != 103) );
+    assert( h3->f( 209 ) == 209.0 && h3->i( 107 ) == 1070 );
+    delete h3;
+
+    //-------------------------------------------
+    // SHAPED HASH - same keys as a plain hash, looked up through an nProp
+    //-------------------------------------------
+    Hash * s1 = new Hash( true );
+    Hash * s2 = new Hash( true );
+    for( int id = 100; id < 106; id++ ) 
+    {
+        s1->i( id, id );
+        s2->i( id, id+1 );
+    }
+    nProp p104( 104 );
+    assert( s1->i( p104 ) == 104 && s2->i( p104 ) == 105 );     // second one hits the cache
+    s2->remove( 101 );
+    assert( !s2->exists( 101 ) && s2->i( p104 ) == 105 && s2->i( 105 ) == 106 );
+    s2->i( 101, 7 );                                            // now in a different order than s1
+    assert( s1->i( p104 ) == 104 && s2->i( p104 ) == 105 && s2->i( 101 ) == 7 );
+    for( int id = 200; id < 210; id++ ) s1->s( id, "x" );       // overflow into table
+    assert( s1->i( p104 ) == 104 && strcmp( s1->s( 209 ), "x" ) == 0 );
+    delete s1;
+    delete s2;
+
+    //-------------------------------------------
+    // HASH CHURN - random sets and removes checked against a plain array
+    //-------------------------------------------
+    const int CHURN_ID_CNT = 1000;
+    Hash * h2 = new Hash;
+    nInt * ref = new nInt[CHURN_ID_CNT];
+    for( int id = 0; id < CHURN_ID_CNT; id++ ) ref[id] = -1;
+    for( int n = 0; n < 200000; n++ )
+    {
+        int id = rand_n( CHURN_ID_CNT );
+        if ( ref[id] >= 0 && heads() ) {
+            h2->remove( id );
+            ref[id] = -1;
+        } else {
+            h2->i( id, n );
+            ref[id] = n;
+        }
+    }
+    int hdl;
+    int cnt = 0;
+    for( int id = h2->id_first( hdl ); id >= 0; id = h2->id_next( hdl ) ) cnt++;
+    for( int id = 0; id < CHURN_ID_CNT; id++ )
+    {
+        assert( h2->exists( id ) == (ref[id] >= 0) );
+        if ( ref[id] >= 0 ) {
+            assert( h2->i( id ) == ref[id] );
+            cnt--;
+        }
+    }
+    assert( cnt == 0 );
+    delete[] ref;
+    delete h2;
+
+    //-------------------------------------------
+    // HASH CAPACITY - reserve up front, shrink back inline
+    //-------------------------------------------
+    Hash * h4 = new Hash;
+    h4->reserve( 100 );
+    for( int id = 0; id < 100; id++ ) h4->i( id, id*3 );
+    for( int id = 0; id < 95; id++ ) h4->remove( id );
+    h4->shrink_to_fit();
+    for( int id = 0; id < 100; id++ ) assert( h4->exists( id ) == (id >= 95) );
+    assert( h4->i( 99 ) == 297 );
+    h4->i( 5, 15 );                                             // inline again, still settable
+    assert( h4->i( 5 ) == 15 && h4->i( 96 ) == 288 );
+    nStats st4;
+    h4->stats( st4 );
+    assert( st4.hash_cnt == 1 && st4.hash_inline_cnt == 1 && st4.hash_prop_cnt == 6 && st4.hash_probe_hist[0] == 6 );
+    delete h4;
+
     //-------------------------------------------
     // LIST
     //-------------------------------------------
@@ -80,5 +380,713 @@ int main( int argc, const char * argv[] )
     l1->unshiftf( 223.476 );
     l1->print( "after unshift" );
 
+    //-------------------------------------------
+    // LIST CAPACITY - bulk build, reserve, shrink
+    //-------------------------------------------
+    nVal vals[100];
+    for( int n = 0; n < 100; n++ ) vals[n].i( n*n );
+    List * l2 = new List( vals, 100 );
+    assert( l2->length() == 100 && l2->i( 99 ) == 9801 );
+    l2->reserve( 1000 );
+    for( int n = 100; n < 1000; n++ ) l2->pushi( n*n );
+    for( int n = 0; n < 998; n++ ) l2->shifti();
+    l2->shrink_to_fit();
+    assert( l2->length() == 2 && l2->i( 0 ) == 998*998 && l2->i( 1 ) == 999*999 );
+    nStats st2;
+    l2->pushhp( new Hash );
+    l2->hp( 2 )->s( 1, "abc" );
+    l2->stats( st2 );
+    assert( st2.list_cnt == 1 && st2.list_entry_cnt == 3 && st2.hash_cnt == 1 && st2.str_bytes == 4 );
+    delete l2->hp( 2 );
+    delete l2;
+    //-------------------------------------------
+    // LIST AS DEQUE - random pushes, pops, shifts and unshifts 
+    // checked against a plain array with room at both ends
+    //-------------------------------------------
+    const int DEQUE_REF_LEN = 400000;
+    nInt * dref = new nInt[DEQUE_REF_LEN];
+    int dfirst = DEQUE_REF_LEN/2;
+    int dend = dfirst;
+    List * l4 = new List;
+    for( int n = 0; n < 100000; n++ )
+    {
+        int op = rand_n( 4 );
+        bool empty = dend == dfirst;
+        if ( op == 0 ) {
+            l4->pushi( n );
+            dref[dend++] = n;
+        } else if ( op == 1 ) {
+            l4->unshifti( n );
+            dref[--dfirst] = n;
+        } else if ( op == 2 && !empty ) {
+            assert( l4->popi() == dref[--dend] );
+        } else if ( op == 3 && !empty ) {
+            assert( l4->shifti() == dref[dfirst++] );
+        }
+        assert( l4->length() == (dend - dfirst) );
+    }
+    for( int k = dfirst; k < dend; k++ ) assert( l4->i( k - dfirst ) == dref[k] );
+    delete l4;
+    delete[] dref;
+
+    //-------------------------------------------
+    // PACKED LIST - all INT or all FLT entries are stored unboxed
+    //-------------------------------------------
+    List * l5 = new List;
+    for( int n = 0; n < 6; n++ ) l5->pushf( n * 0.5 );         // more than fit unpacked inline
+    assert( l5->packed_kind() == FLT && l5->fp()[5] == 2.5 && l5->ip() == nullptr );
+    l5->fp()[1] = 7.0;
+    assert( l5->f( 1 ) == 7.0 && l5->kind( 3 ) == FLT );
+    l5->pushs( "x" );                                           // unpacks
+    assert( l5->packed_kind() == UNDEF && l5->fp() == nullptr );
+    assert( l5->f( 1 ) == 7.0 && l5->f( 5 ) == 2.5 && strcmp( l5->s( 6 ), "x" ) == 0 );
+    l5->pops();
+    while( l5->length() != 0 ) l5->popf();
+    l5->pushi( 3 );                                             // empty, so packs again
+    l5->unshifti( 2 );
+    assert( l5->packed_kind() == INT && l5->ip()[0] == 2 && l5->ip()[1] == 3 );
+    delete l5;
+    vals[50].f( 2500.0 );
+    List * l6 = new List( vals, 100 );                          // mixed, so not packed
+    List * l7 = new List( vals, 50 );
+    assert( l6->packed_kind() == UNDEF && l6->f( 50 ) == 2500.0 && l6->i( 49 ) == 2401 );
+    assert( l7->packed_kind() == INT && l7->ip()[49] == 2401 );
+    delete l6;
+    delete l7;
+    vals[50].i( 2500 );
+
+    //-------------------------------------------
+    // ARENA - tables, entry arrays and strings all come from the arena
+    //-------------------------------------------
+    nArena * arena = new nArena( 4096 );
+    Hash * ah = arena->hash_new();
+    List * al = arena->list_new();
+    for( int n = 0; n < 1000; n++ ) 
+    {
+        ah->s( n, "arena" );
+        al->pushi( n );
+    }
+    al->pushs( "x" );                                           // unpack, in the arena
+    List * al2 = arena->list_new( vals, 100 );
+    assert( strcmp( ah->s( 999 ), "arena" ) == 0 && al->i( 999 ) == 999 && al2->i( 10 ) == 100 );
+    assert( arena->bytes() > 1000 * int(sizeof( nVal )) );
+
+    for( int c = 0; c < 3; c++ )                                // adopted blocks go with a release to an earlier mark
+    {
+        long         before = arena->bytes();
+        nArena::Mark am     = arena->mark();
+        size_t       len    = (c == 0) ? 16 : 4000;            // 4000 starts a new block since the mark
+        arena->alloc( len );
+        long         used   = arena->bytes();
+        nArena other( 4096 );
+        other.strdup( "adopted" );
+        long         other_bytes = other.bytes();
+        arena->adopt( other );
+        assert( other.bytes() == 0 && arena->bytes() == used + other_bytes );
+        if ( c == 2 ) {                                         // a mark after adopt() keeps them
+            nArena::Mark am2 = arena->mark();
+            arena->alloc( 4000 );
+            arena->release( am2 );
+            assert( arena->bytes() == used + other_bytes );
+        }
+        arena->release( am );
+        assert( arena->bytes() == before );
+        assert( strcmp( arena->strdup( "after" ), "after" ) == 0 );
+    }
+    delete arena;
+
+    //-------------------------------------------
+    // DEDUPE - identical subtrees parse to one object, in the arena or not,
+    // and stats count each once
+    //-------------------------------------------
+    const char * dedupe_path = "_test_node.tmp";
+    FILE * dedupe_file = fopen( dedupe_path, "w" );
+    assert( dedupe_file != nullptr );
+    fprintf( dedupe_file, "[ { a: 1, b: [1, 2], c: \"x\" }, { c: \"x\", b: [1, 2], a: 1 }, { a: 1, b: [1, 2], c: \"y\" },\n" );
+    fprintf( dedupe_file, "  [1, 2], [1.0, 2], { p: { q: [x] } }, { p: { q: [x] } } ]\n" );
+    fclose( dedupe_file );
+    for( int use_arena = 0; use_arena < 2; use_arena++ )
+    {
+        nArena * darena = use_arena ? new nArena( 4096 ) : nullptr;
+        NodeIO * dio = new NodeIO( dedupe_path );
+        dio->dedupe_set( true );
+        dio->arena_set( darena );
+        List * dl = dio->list_parse();
+        nStats dst;
+        dio->stats( dst );
+        delete dio;
+
+        assert( dl->length() == 7 );
+        assert( dl->hp( 0 ) == dl->hp( 1 ) );                  // property order doesn't matter
+        assert( dl->hp( 0 ) != dl->hp( 2 ) && strcmp( dl->h( 2 ).s( Hash::str_to_id( "c" ) ), "y" ) == 0 );
+        assert( dl->lp( 3 ) == dl->h( 0 ).lp( Hash::str_to_id( "b" ) ) );
+        assert( dl->lp( 4 ) != dl->lp( 3 ) );                   // 1.0 is not 1
+        assert( dl->hp( 5 ) == dl->hp( 6 ) );
+        assert( dst.parse_node_cnt == 15 && dst.parse_shared_cnt == 7 );
+        dl->stats( dst );
+        dl->stats( dst );
+        assert( dst.hash_cnt == 4 && dst.list_cnt == 4 );        // shared nodes counted once
+        if ( darena != nullptr ) {
+            delete darena;
+        } else {
+            delete dl;
+        }
+    }
+    remove( dedupe_path );
+
+    //-------------------------------------------
+    // LONG LINES - one line of several blocks, so tokens straddle blocks,
+    // and one string longer than a block.  Read gzipped, then mapped, 
+    // then mapped with strings left in place.
+    //-------------------------------------------
+    const int    LONG_CNT   = 100000;
+    const int    LONG_S_LEN = 3 << 20;
+    const char * long_path  = "_test_node.tmp";
+    std::string  long_text  = "# comment\n[";
+    for( int n = 0; n < LONG_CNT; n++ ) 
+    {
+        sprintf( name, "%d", n );
+        long_text += std::string( "{ s: \"s" ) + name + "\", i: " + name + ", f: -" + name + ".5 }, ";
+    }
+    long_text += "\"a\\\"b\\\\c\", \"";
+    for( int n = 0; n < LONG_S_LEN; n++ ) long_text += char( 'a' + n % 26 );
+    long_text += "\" ]\n";
+    for( int mode = 0; mode < 3; mode++ )
+    {
+        if ( mode == 0 ) {
+            gzFile long_file = gzopen( long_path, "w" );
+            assert( long_file != nullptr && gzwrite( long_file, long_text.c_str(), long_text.size() ) == int(long_text.size()) );
+            gzclose( long_file );
+        } else {
+            FILE * long_file = fopen( long_path, "w" );
+            assert( long_file != nullptr && fwrite( long_text.c_str(), 1, long_text.size(), long_file ) == long_text.size() );
+            fclose( long_file );
+        }
+        nArena * long_arena = (mode == 2) ? new nArena : nullptr;
+        NodeIO * long_io = new NodeIO( long_path );
+        assert( long_io->mapped() == (mode != 0) );
+        long_io->arena_set( long_arena );
+        long_io->str_in_place_set( true );                      // ignored without an arena
+        List * long_l = long_io->list_parse();
+        delete long_io;
+        remove( long_path );                                    // the mapping stays valid
+        assert( long_l->length() == LONG_CNT+2 );
+        for( int n = 0; n < LONG_CNT; n++ )
+        {
+            Hash& lh = long_l->h( n );
+            sprintf( name, "s%d", n );
+            assert( strcmp( lh.s( Hash::str_to_id( "s" ) ), name ) == 0 );
+            assert( lh.i( Hash::str_to_id( "i" ) ) == n && lh.f( Hash::str_to_id( "f" ) ) == -(n + 0.5) );
+        }
+        assert( strcmp( long_l->s( LONG_CNT ), "a\"b\\c" ) == 0 );
+        nStr long_s = long_l->s( LONG_CNT+1 );
+        assert( int(strlen( long_s )) == LONG_S_LEN && long_s[LONG_S_LEN-1] == 'a' + (LONG_S_LEN-1) % 26 );
+        delete long_arena;
+    }
+
+    //-------------------------------------------
+    // MAPPED - a file of exactly one page still gets its terminating NUL
+    //-------------------------------------------
+    std::string page_text = "[ \"page\" ]\n#";
+    page_text.resize( sysconf( _SC_PAGESIZE ) - 1, ' ' );
+    page_text += '\n';
+    FILE * page_file = fopen( long_path, "w" );
+    assert( page_file != nullptr && fwrite( page_text.c_str(), 1, page_text.size(), page_file ) == page_text.size() );
+    fclose( page_file );
+    nArena * page_arena = new nArena;
+    NodeIO * page_io = new NodeIO( long_path );
+    page_io->arena_set( page_arena );
+    page_io->str_in_place_set( true );
+    List * page_l = page_io->list_parse();
+    delete page_io;
+    remove( long_path );
+    assert( page_l->length() == 1 && strcmp( page_l->s( 0 ), "page" ) == 0 );
+    delete page_arena;
+
+    //-------------------------------------------
+    // STREAMING - events and one element at a time
+    //-------------------------------------------
+    const char * stream_path = "_test_node.tmp";
+    FILE * stream_file = fopen( stream_path, "w" );
+    assert( stream_file != nullptr );
+    fprintf( stream_file, "[ { a: 1, b: [2, 3.5, x], c: \"s\" }, 7, [], \"t\", ]\n" );
+    fclose( stream_file );
+    EventText events;
+    NodeIO * stream_io = new NodeIO( stream_path );
+    assert( stream_io->events_parse( events ) );
+    delete stream_io;
+    assert( events.text == "[{a:1 b:[2 3.500000 x ]c:s }7 []t ]" );
+    events.text = "";
+    events.stop_at_int = true;
+    stream_io = new NodeIO( stream_path );
+    assert( !stream_io->events_parse( events ) && events.text == "[{a:1 " );
+    delete stream_io;
+
+    nVal elem;
+    stream_io = new NodeIO( stream_path );
+    assert( stream_io->elem_next( elem ) && elem.kind() == HASH && elem.hp()->l( Hash::str_to_id( "b" ) ).length() == 3 );
+    delete elem.hp();
+    assert( stream_io->elem_next( elem ) && elem.kind() == INT && elem.i() == 7 );
+    assert( stream_io->elem_next( elem ) && elem.kind() == LIST && elem.lp()->length() == 0 );
+    delete elem.lp();
+    assert( stream_io->elem_next( elem ) && elem.kind() == STR && strcmp( elem.s(), "t" ) == 0 );
+    free( const_cast<char *>( elem.s() ) );
+    assert( !stream_io->elem_next( elem ) && !stream_io->elem_next( elem ) );
+    delete stream_io;
+
+    stream_file = fopen( stream_path, "w" );
+    assert( stream_file != nullptr );
+    fprintf( stream_file, "[\n" );
+    for( int n = 0; n < 20000; n++ ) fprintf( stream_file, "{ n: %d, name: \"element %d\", xyz: [%d, %d, %d] },\n", n, n, n, n+1, n+2 );
+    fprintf( stream_file, "]\n" );
+    fclose( stream_file );
+    nArena * stream_arena = new nArena( 4096 );
+    stream_io = new NodeIO( stream_path );
+    stream_io->arena_set( stream_arena );
+    int stream_cnt = 0;
+    for( ;; )
+    {
+        nArena::Mark m = stream_arena->mark();
+        if ( !stream_io->elem_next( elem ) ) break;
+        assert( elem.hp()->i( Hash::str_to_id( "n" ) ) == stream_cnt && elem.hp()->l( Hash::str_to_id( "xyz" ) ).i( 2 ) == stream_cnt+2 );
+        stream_cnt++;
+        stream_arena->release( m );
+    }
+    assert( stream_cnt == 20000 && stream_arena->bytes() == 0 );      // everything given back each time
+    delete stream_io;
+    delete stream_arena;
+    remove( stream_path );
+
+    //-------------------------------------------
+    // PARALLEL - the top-level list split over threads, with commas and 
+    // brackets inside strings and comments, and a list repeated in every
+    // element for dedupe.  Read gzipped, mapped, then mapped into an arena.
+    //-------------------------------------------
+    const int    PAR_CNT  = 40000;
+    const char * par_path = "_test_node.tmp";
+    std::string  par_text = "[\n";
+    for( int n = 0; n < PAR_CNT; n++ ) 
+    {
+        sprintf( name, "%d", n );
+        par_text += std::string( "{ s: \"s,[" ) + name + "]\\\"}\", i: " + name + ", l: [ 1, 2 ], h: { f: " + name + ".5 } },  # ], {\n";
+    }
+    par_text += "]\n";
+    for( int mode = 0; mode < 3; mode++ )
+    {
+        if ( mode == 0 ) {
+            gzFile par_file = gzopen( par_path, "w" );
+            assert( par_file != nullptr && gzwrite( par_file, par_text.c_str(), par_text.size() ) == int(par_text.size()) );
+            gzclose( par_file );
+        } else {
+            FILE * par_file = fopen( par_path, "w" );
+            assert( par_file != nullptr && fwrite( par_text.c_str(), 1, par_text.size(), par_file ) == par_text.size() );
+            fclose( par_file );
+        }
+        nArena * par_arena = (mode == 2) ? new nArena : nullptr;
+        NodeIO * par_io = new NodeIO( par_path );
+        par_io->arena_set( par_arena );
+        par_io->dedupe_set( mode == 0 );
+        par_io->threads_set( 4 );
+        List * par_l = par_io->list_parse();
+        nStats par_st;
+        par_io->stats( par_st );
+        delete par_io;
+        remove( par_path );
+        assert( par_l->length() == PAR_CNT );
+        assert( par_st.parse_node_cnt == 3*PAR_CNT+1 && (mode == 0) == (par_st.parse_shared_cnt > 0) );
+        for( int n = 0; n < PAR_CNT; n++ )
+        {
+            Hash& ph = par_l->h( n );
+            sprintf( name, "s,[%d]\"}", n );
+            assert( strcmp( ph.s( Hash::str_to_id( "s" ) ), name ) == 0 && ph.i( Hash::str_to_id( "i" ) ) == n );
+            assert( ph.l( Hash::str_to_id( "l" ) ).i( 1 ) == 2 && ph.h( Hash::str_to_id( "h" ) ).f( Hash::str_to_id( "f" ) ) == n + 0.5 );
+        }
+        delete par_arena;
+    }
+
+    //-------------------------------------------
+    // IMAGE - write a tree with every kind of node, map it back, map it 
+    // again while the first is still there (so it has to move), change 
+    // it, then read one written by a process with different ids.  Pooled
+    // strings come back pooled.
+    //-------------------------------------------
+    const char * img_path = "_test_node.tmp";
+    Hash * img_h = new Hash;
+    img_h->i( Hash::str_to_id( "n" ), 42 ).f( Hash::str_to_id( "x" ), -2.5 ).s( Hash::str_to_id( "name" ), "inline" );
+    Hash * img_shaped = new Hash( true );
+    img_shaped->i( Hash::str_to_id( "n" ), 7 ).sp( Hash::str_to_id( "name" ), pooled_gray );
+    Hash * img_big = new Hash;
+    List * img_ints = new List;
+    List * img_flts = new List;
+    List * img_q = new List;
+    for( int n = 0; n < 20; n++ ) 
+    {
+        sprintf( name, "img_p%d", n );
+        img_big->i( Hash::str_to_id( name ), n );
+        if ( n < 10 ) img_ints->pushi( n );
+        if ( n < 6 ) img_q->pushs( name );
+    }
+    img_flts->pushf( 1.5 ).pushf( 2.5 );
+    img_q->shifts();
+    img_q->shifts();
+    List * img_l = new List;
+    img_l->pushhp( img_h ).pushhp( img_shaped ).pushhp( img_big ).pushlp( img_ints ).pushlp( img_flts ).pushlp( img_q );
+    img_l->pushlp( new List ).pushhp( img_h ).pushs( pooled_gray ).pushi( -1 );
+    std::string img_text = tree_text( img_l );
+    nImage::write( img_path, img_l );
+
+    nArena * img_arena1 = new nArena;
+    NodeIO * img_io = new NodeIO( img_path );
+    assert( img_io->mapped() );
+    img_io->arena_set( img_arena1 );
+    List * img_l1 = img_io->list_parse();
+    delete img_io;
+    assert( tree_text( img_l1 ) == img_text && img_l1->hp( 0 ) == img_l1->hp( 7 ) );   // still shared
+    nArena * img_arena2 = new nArena;
+    img_io = new NodeIO( img_path );
+    img_io->arena_set( img_arena2 );
+    List * img_l2 = img_io->list_parse();
+    delete img_io;
+    remove( img_path );
+    assert( img_l2 != img_l1 && tree_text( img_l2 ) == img_text );
+    for( int n = 0; n < 20; n++ ) 
+    {
+        sprintf( name, "img_p%d", n );
+        img_l2->h( 0 ).i( Hash::str_to_id( name ), n+100 );   // outgrows the object
+    }
+    img_l2->l( 3 ).pushi( 10 );
+    img_l2->l( 5 ).unshifts( "img_p1" );
+    assert( img_l2->h( 0 ).i( Hash::str_to_id( "img_p19" ) ) == 119 && img_l2->h( 0 ).i( Hash::str_to_id( "n" ) ) == 42 );
+    assert( img_l2->l( 3 ).i( 10 ) == 10 && img_l2->l( 5 ).length() == 5 && strcmp( img_l2->l( 5 ).s( 0 ), "img_p1" ) == 0 );
+    assert( tree_text( img_l1 ) == img_text );
+    delete img_arena2;
+    delete img_arena1;
+
+    pid_t img_pid = fork();
+    if ( img_pid == 0 ) {
+        for( int n = 0; n < 100; n++ ) 
+        {
+            sprintf( name, "img_pad%d", n );
+            Hash::str_to_id( name );
+        }
+        Hash * ch = new Hash;
+        for( int n = 0; n < 30; n++ ) 
+        {
+            sprintf( name, "img_c%d", n );
+            ch->i( Hash::str_to_id( name ), n );
+        }
+        List * cl = new List;
+        cl->pushhp( ch ).pushhp( &(new Hash)->s( Hash::str_to_id( "img_c7" ), "seven" ) );
+        nImage::write( img_path, cl );
+        _exit( 0 );
+    }
+    int img_status;
+    assert( img_pid > 0 && waitpid( img_pid, &img_status, 0 ) == img_pid && img_status == 0 );
+    nArena * img_arena3 = new nArena;
+    img_io = new NodeIO( img_path );
+    img_io->arena_set( img_arena3 );
+    List * img_l3 = img_io->list_parse();
+    delete img_io;
+    remove( img_path );
+    for( int n = 0; n < 30; n++ ) 
+    {
+        sprintf( name, "img_c%d", n );
+        assert( img_l3->h( 0 ).i( Hash::str_to_id( name ) ) == n );
+    }
+    assert( strcmp( img_l3->h( 1 ).s( Hash::str_to_id( "img_c7" ) ), "seven" ) == 0 );
+    delete img_arena3;
+
+    const char * img_text_path = "_test_node.tmp.txt";
+    FILE * img_file = fopen( img_text_path, "w" );
+    fputs( "[ { kind: \"geom\", name: \"img_pool\" }, \"geom\" ]\n", img_file );
+    fclose( img_file );
+    for( int mode = 0; mode < 2; mode++ )
+    {
+        nArena * img_arena4 = new nArena;
+        img_io = new NodeIO( (mode == 0) ? img_text_path : img_path );
+        img_io->arena_set( img_arena4 );
+        img_io->str_pool_set( true );
+        List * img_l4 = img_io->list_parse();
+        delete img_io;
+        assert( img_l4->h( 0 ).s( Hash::id_kind ) == Hash::str_pooled( "geom" ) && img_l4->s( 1 ) == Hash::str_pooled( "geom" ) );
+        assert( img_l4->h( 0 ).s( Hash::str_to_id( "name" ) ) == Hash::str_pooled( "img_pool" ) );
+        if ( mode == 0 ) nImage::write( img_path, img_l4 );
+        delete img_arena4;
+    }
+    remove( img_text_path );
+    remove( img_path );
+
+    //-------------------------------------------
+    // WRITER - a tree written plain or gzipped reads back the same, a
+    // file copied through events_parse() comes out the same, and a 
+    // streamed list reads back.
+    //-------------------------------------------
+    const char * wr_path  = "_test_node.tmp";
+    const char * wr_path2 = "_test_node2.tmp";
+    Hash * wr_h = new Hash;
+    wr_h->i( Hash::str_to_id( "n" ), -1234567890123L ).f( Hash::str_to_id( "x" ), 0.1 ).s( Hash::str_to_id( "name" ), "say \"hi\" \\ bye" );
+    wr_h->hp( Hash::str_to_id( "empty" ), new Hash ).lp( Hash::str_to_id( "ints" ), &(new List)->pushi( 1 ).pushi( -2 ) );
+    List * wr_l = new List;
+    wr_l->pushhp( wr_h ).pushf( -2.5 ).pushf( 1e-7 ).pushf( 123456789.0 ).pushf( -0.0 ).pushf( 1e17 );
+    wr_l->pushs( "" ).pushlp( new List ).pushlp( &(new List)->pushf( 0.25 ).pushf( 3.0 ) ).pushi( 0 );
+    std::string wr_text = tree_text( wr_l );
+    wr_h->undef( Hash::str_to_id( "gone" ) );                   // not written
+    for( int level = 6; level >= 0; level -= 6 )
+    {
+        NodeIOWriter * wr = new NodeIOWriter( wr_path, level );
+        wr->list_write( wr_l );
+        delete wr;
+        nArena * wr_arena = new nArena;
+        NodeIO * wr_io = new NodeIO( wr_path );
+        assert( wr_io->mapped() == (level == 0) );
+        wr_io->arena_set( wr_arena );
+        List * wr_back = wr_io->list_parse();
+        delete wr_io;
+        assert( tree_text( wr_back ) == wr_text && !wr_back->h( 0 ).exists( Hash::str_to_id( "gone" ) ) );
+        assert( wr_back->f( 2 ) == 1e-7 && wr_back->f( 5 ) == 1e17 && signbit( wr_back->f( 4 ) ) && wr_back->l( 8 ).packed_kind() == FLT );
+        delete wr_arena;
+    }
+    NodeIOWriter * wr_copy = new NodeIOWriter( wr_path2 );
+    NodeIO * wr_io = new NodeIO( wr_path );
+    assert( wr_io->events_parse( *wr_copy ) );
+    delete wr_io;
+    delete wr_copy;
+    std::string wr_file[2];
+    for( int k = 0; k < 2; k++ )
+    {
+        FILE * wr_file_hdl = fopen( k ? wr_path2 : wr_path, "r" );
+        for( int c = fgetc( wr_file_hdl ); c != EOF; c = fgetc( wr_file_hdl ) ) wr_file[k] += char( c );
+        fclose( wr_file_hdl );
+    }
+    assert( wr_file[0] == wr_file[1] && wr_file[0].compare( 0, 3, "[\n{" ) == 0 );
+
+    NodeIOWriter * wr_stream = new NodeIOWriter( wr_path, 1 );
+    wr_stream->list_begin();
+    for( int n = 0; n < 10000; n++ )
+    {
+        wr_stream->hash_begin();
+        wr_stream->key( Hash::str_to_id( "n" ) );
+        wr_stream->i( n );
+        wr_stream->key( Hash::str_to_id( "name" ) );
+        wr_stream->s( "x" );
+        wr_stream->hash_end();
+    }
+    wr_stream->list_end();
+    assert( wr_stream->text_len() > 10000*20 );
+    delete wr_stream;
+    wr_io = new NodeIO( wr_path );
+    List * wr_streamed = wr_io->list_parse();
+    delete wr_io;
+    assert( wr_streamed->length() == 10000 && wr_streamed->h( 9999 ).i( Hash::str_to_id( "n" ) ) == 9999 );
+    remove( wr_path );
+    remove( wr_path2 );
+
+    //-------------------------------------------
+    // INDEX - jump to elements of a file gzipped in two members, then of
+    // the same file plain, with empty elements and separators inside 
+    // strings and comments.  Jumping back works with strings in place
+    // and after a parallel parse.
+    // Changing the file retires its index.
+    //-------------------------------------------
+    const int    IDX_CNT  = 20000;
+    const char * idx_path = "_test_node.tmp";
+    char         idx_idx_path[64];
+    sprintf( idx_idx_path, "%s.idx", idx_path );
+    std::string  idx_text[2] = { "# [ not yet\n[ ,\n", "" };
+    for( int n = 0; n < IDX_CNT; n++ ) 
+    {
+        sprintf( name, "%d", n );
+        idx_text[n >= IDX_CNT/2] += std::string( "{ s: \"s,[" ) + name + "]\\\"}\", i: " + name + " },  # ], {\n" + ((n % 7 == 0) ? " ,\n" : "");
+    }
+    idx_text[1] += "]\n";
+    int idx_seeks[] = { 0, 1, 7, IDX_CNT/2 - 1, IDX_CNT/2, 12345, IDX_CNT - 1 };
+    for( int mode = 0; mode < 2; mode++ )
+    {
+        for( int k = 0; k < 2; k++ )
+        {
+            if ( mode == 0 ) {
+                gzFile idx_file = gzopen( idx_path, k ? "a" : "w" );
+                assert( idx_file != nullptr && gzwrite( idx_file, idx_text[k].c_str(), idx_text[k].size() ) == int(idx_text[k].size()) );
+                gzclose( idx_file );
+            } else {
+                FILE * idx_file = fopen( idx_path, k ? "a" : "w" );
+                assert( idx_file != nullptr && fwrite( idx_text[k].c_str(), 1, idx_text[k].size(), idx_file ) == idx_text[k].size() );
+                fclose( idx_file );
+            }
+        }
+        NodeIO * idx_io = new NodeIO( idx_path );
+        assert( idx_io->elem_cnt() == -1 );
+        delete idx_io;
+        nIndex::write( idx_path, 1 << 16 );
+        nIndex * idx = nIndex::open( idx_path );
+        assert( idx != nullptr && idx->elem_cnt() == IDX_CNT && idx->compressed() == (mode == 0) && idx->elem_line( 0 ) == 2 );
+        delete idx;
+
+        nArena * idx_arena = new nArena;
+        idx_io = new NodeIO( idx_path );
+        idx_io->arena_set( idx_arena );
+        assert( idx_io->elem_cnt() == IDX_CNT );
+        for( int n : idx_seeks )
+        {
+            nVal v;
+            idx_io->elem_seek( n );
+            for( int m = n; m < n + 3 && m < IDX_CNT; m++ )
+            {
+                sprintf( name, "s,[%d]\"}", m );
+                assert( idx_io->elem_next( v ) && v.kind() == HASH && v.hp()->i( Hash::str_to_id( "i" ) ) == m );
+                assert( strcmp( v.hp()->s( Hash::str_to_id( "s" ) ), name ) == 0 );
+            }
+        }
+        List * idx_l = idx_io->list_parse( IDX_CNT - 10, 100 );
+        assert( idx_l->length() == 10 && idx_l->h( 9 ).i( Hash::str_to_id( "i" ) ) == IDX_CNT - 1 );
+        idx_l = idx_io->list_parse( 100, 1000 );
+        assert( idx_l->length() == 1000 && idx_l->h( 0 ).i( Hash::str_to_id( "i" ) ) == 100 );
+        nVal idx_v;
+        idx_io->elem_seek( IDX_CNT );
+        assert( !idx_io->elem_next( idx_v ) );
+        delete idx_io;
+
+        idx_io = new NodeIO( idx_path );
+        idx_io->arena_set( idx_arena );
+        idx_io->str_in_place_set( true );
+        for( int pass = 0; pass < 2; pass++ )                   // the text read the first time is still intact
+        {
+            idx_io->elem_seek( 5 );
+            for( int m = 5; m < 8; m++ )
+            {
+                sprintf( name, "s,[%d]\"}", m );
+                assert( idx_io->elem_next( idx_v ) && strcmp( idx_v.hp()->s( Hash::str_to_id( "s" ) ), name ) == 0 );
+            }
+        }
+        delete idx_io;
+
+        idx_io = new NodeIO( idx_path );
+        idx_io->arena_set( idx_arena );
+        idx_io->threads_set( 4 );
+        idx_l = idx_io->list_parse();
+        assert( idx_l->length() == IDX_CNT );
+        for( int n = 0; n < IDX_CNT; n += (mode == 0) ? 997 : 1 )   // every chunk boundary, when mapped
+        {
+            idx_io->elem_seek( n );
+            assert( idx_io->elem_next( idx_v ) && idx_v.hp()->i( Hash::str_to_id( "i" ) ) == n );
+        }
+        delete idx_io;
+        delete idx_arena;
+
+        FILE * idx_file = fopen( idx_path, "a" );
+        fputc( '\n', idx_file );
+        fclose( idx_file );
+        assert( nIndex::open( idx_path ) == nullptr );
+        remove( idx_path );
+        remove( idx_idx_path );
+    }
+
+    //-------------------------------------------
+    // CODECS - each codec this build has reads back, recognized by its 
+    // magic, on one thread or several, and can be indexed.  The list is 
+    // long enough for several gzip members or zstd or lz4 frames.
+    //-------------------------------------------
+    const int    CODEC_CNT  = 200000;
+    const char * codec_path = "_test_node.tmp";
+    char         codec_idx_path[64];
+    sprintf( codec_idx_path, "%s.idx", codec_path );
+    const nCodec codecs[] = { CODEC_GZIP, CODEC_ZSTD, CODEC_LZ4 };
+    for( nCodec codec : codecs )
+    {
+        if ( !NodeIO::codec_built( codec ) ) continue;
+        NodeIOWriter * codec_wr = new NodeIOWriter( codec_path, 1, codec );
+        codec_wr->threads_set( 2 );
+        codec_wr->list_begin();
+        for( int n = 0; n < CODEC_CNT; n++ )
+        {
+            sprintf( name, "x%d", n );
+            codec_wr->hash_begin();
+            codec_wr->key( Hash::str_to_id( "n" ) );
+            codec_wr->i( n );
+            codec_wr->key( Hash::str_to_id( "name" ) );
+            codec_wr->s( name );
+            codec_wr->hash_end();
+        }
+        codec_wr->list_end();
+        delete codec_wr;
+        assert( NodeIO::codec( codec_path ) == codec );
+
+        nArena * codec_arena = new nArena;
+        NodeIO * codec_io;
+        for( int codec_threads = 1; codec_threads <= 4; codec_threads += 3 )
+        {
+            codec_io = new NodeIO( codec_path );
+            codec_io->arena_set( codec_arena );
+            codec_io->threads_set( codec_threads );
+            List * codec_l = codec_io->list_parse();
+            delete codec_io;
+            assert( codec_l->length() == CODEC_CNT && codec_l->h( CODEC_CNT-1 ).i( Hash::str_to_id( "n" ) ) == CODEC_CNT-1 );
+            assert( strcmp( codec_l->h( 4321 ).s( Hash::str_to_id( "name" ) ), "x4321" ) == 0 );
+        }
+
+        nIndex::write( codec_path, 1 << 20 );
+        codec_io = new NodeIO( codec_path );
+        codec_io->arena_set( codec_arena );
+        assert( codec_io->elem_cnt() == CODEC_CNT );
+        int codec_seeks[] = { CODEC_CNT-1, 7, CODEC_CNT/2 };
+        for( int n : codec_seeks )
+        {
+            nVal v;
+            codec_io->elem_seek( n );
+            assert( codec_io->elem_next( v ) && v.hp()->i( Hash::str_to_id( "n" ) ) == n );
+        }
+        delete codec_io;
+        delete codec_arena;
+        remove( codec_path );
+        remove( codec_idx_path );
+    }
+
+    //-------------------------------------------
+    // GUNZIP - many gzip members, stored or deflated, read on several 
+    // threads.  Strings hold copies of the gzip header that stored members
+    // leave in the file as is, and junk follows the last member.
+    //-------------------------------------------
+    const int    GZ_MEMBERS = 40;
+    const int    GZ_CNT     = 500;
+    const char * gz_path    = "_test_node.tmp";
+    for( int k = 0; k < GZ_MEMBERS; k++ )
+    {
+        std::string gz_text = (k == 0) ? "[\n" : "";
+        for( int n = k*GZ_CNT; n < (k+1)*GZ_CNT; n++ )
+        {
+            sprintf( name, "%d", n );
+            gz_text += std::string( "{ s: \"\x1f\x8b\x08\x01" ) + name + "\", i: " + name + " }" + ((n < GZ_MEMBERS*GZ_CNT-1) ? ",\n" : "\n]\n");
+        }
+        gzFile gz_file = gzopen( gz_path, (k == 0) ? "wb0" : (k % 3 == 0) ? "ab9" : "ab0" );
+        assert( gz_file != nullptr && gzwrite( gz_file, gz_text.c_str(), gz_text.size() ) == int(gz_text.size()) );
+        gzclose( gz_file );
+    }
+    FILE * gz_junk = fopen( gz_path, "a" );
+    fwrite( "\0\0\0\0", 1, 4, gz_junk );
+    fclose( gz_junk );
+    for( int gz_threads = 1; gz_threads <= 3; gz_threads++ )
+    {
+        nArena * gz_arena = new nArena;
+        NodeIO * gz_io = new NodeIO( gz_path );
+        gz_io->arena_set( gz_arena );
+        gz_io->threads_set( gz_threads );
+        nVal v;
+        int  gz_n = 0;
+        for( ; gz_io->elem_next( v ); gz_n++ )
+        {
+            sprintf( name, "\x1f\x8b\x08\x01%d", gz_n );
+            assert( v.kind() == HASH && v.hp()->i( Hash::str_to_id( "i" ) ) == gz_n );
+            assert( strcmp( v.hp()->s( Hash::str_to_id( "s" ) ), name ) == 0 );
+        }
+        assert( gz_n == GZ_MEMBERS*GZ_CNT );
+        delete gz_io;
+        delete gz_arena;
+    }
+    remove( gz_path );
+
+    List * l3 = new List( vals, 3 );
+    assert( l3->length() == 3 && l3->i( 2 ) == 4 && !l3->exists( 3 ) );
+    delete l3;
+
     return 0;
 }
@@ -48,7 +48,12 @@ ifeq ($(OS), Linux)
 
 GLUT_DIR = /home/utils/freeglut-2.8.1
 CFLAGS = -Wall -Werror -pedantic -Wno-long-long -Wno-deprecated -O3 -g -DEMULATE_BUFFERS -I../base -I${GLUT_DIR}/include
-LFLAGS = -g -lm -lz -lstdc++ -lGL -lglut -lGLU -L${GLUT_DIR}/lib
+LFLAGS = -g -lm -lz -lstdc++ -lpthread -lGL -lglut -lGLU -L${GLUT_DIR}/lib
+
+# x86-64 guarantees only SSE2; "make AVX2=1" builds the AVX2 paths too
+ifdef AVX2
+CFLAGS += -mavx2
+endif
 
 ############################
 # MACOS OVERRIDES
@@ -69,7 +74,7 @@ else
 ifneq (,$(findstring CYGWIN, $(OS)))
 
 CFLAGS = -Wall -Werror -pedantic -O3 -g -DEMULATE_BUFFERS -I../base
-LFLAGS = -g -lm -lz -lstdc++ -lGL -lglu32 -lglut
+LFLAGS = -g -lm -lz -lstdc++ -lpthread -lGL -lglu32 -lglut
 
 else
 $(error Unknown O/S: $(OS))
@@ -87,7 +92,7 @@ LFLAGS += $(EXTRA_LFLAGS)
 
 RUNS = $(PROGS:.exe=.run)
 
-all: $(OBJS) $(PROGS)
+all: $(OBJS) $(PROGS) $(BENCHES)
 
 check: $(RUNS)
 
@@ -123,5 +128,5 @@ regress:
 	echo "ALL PASSED"
 
 clean:
-	rm -fr *.o *.s *.exe .libs *.gz *.out ._* .libs $(PROGS) *.stackdump *.mp4 *.cxx *.vcmc *.vmc
+	rm -fr *.o *.s *.exe .libs *.gz *.out ._* .libs $(PROGS) $(BENCHES) *.stackdump *.mp4 *.cxx *.vcmc *.vmc
 
@@ -43,22 +43,29 @@ public:
     // Viz Info
     //------------------------------------------------------------
     NodeIO *            viz_nodeio;                                                     // handle on parser for viz file
+    nArena *            viz_arena;                                                      // holds everything parsed from viz file
     List *              viz_list;                                                       // listof things to visualize
     Entity **           viz_entities;                                                   // allocated World entities
     Hash                viz_id_to_entity_index;                                         // maps id to index into viz_entrities
     int                 viz_last;                                                       // draw everything through this position in list
 
-    int                 id_line;
-    int                 id_kind;
-    int                 id_shape;
-    int                 id_color;
-    int                 id_x;
-    int                 id_y;
-    int                 id_z;
-    int                 id_w;
-    int                 id_h;
-    int                 id_d;
-    int                 id_index;
+    nProp               prop_line;                                                      // property lookups with inline caches
+    nProp               prop_kind;
+    nProp               prop_index;
+    nProp               prop_shape;
+    nProp               prop_shape_kind;                                                // separate cache for the shape's own layout
+    nProp               prop_color;
+    nProp               prop_x;
+    nProp               prop_y;
+    nProp               prop_z;
+    nProp               prop_w;
+    nProp               prop_h;
+    nProp               prop_d;
+
+    nStr                str_geom;                                                       // pooled kind strings, compared by address
+    nStr                str_box;
+    nStr                str_hide;
+    nStr                str_unhide;
 
     //------------------------------------------------------------
     // GUI
@@ -86,23 +93,30 @@ Viz::Viz( ConfigViz * config, Sys * sys )
     // read in viz_file
     //----------------------------------------------------------------
     if ( !impl->config->viz_path ) error( "no -viz_path supplied" );
+    impl->viz_arena = new nArena;
     impl->viz_nodeio = new NodeIO( impl->config->viz_path );
+    impl->viz_nodeio->shaped_set( true );
+    impl->viz_nodeio->arena_set( impl->viz_arena );
+    impl->viz_nodeio->str_pool_set( true );
     impl->viz_list = impl->viz_nodeio->list_parse();
 
-    //----------------------------------------------------------------
-    // Get fast ids for hash field names that we really care about.
-    //----------------------------------------------------------------
-    impl->id_line  = Hash::str_to_id( "line" ); 
-    impl->id_kind  = Hash::str_to_id( "kind" ); 
-    impl->id_shape = Hash::str_to_id( "shape" );
-    impl->id_color = Hash::str_to_id( "color" );
-    impl->id_x     = Hash::str_to_id( "x" );
-    impl->id_y     = Hash::str_to_id( "y" );
-    impl->id_z     = Hash::str_to_id( "z" );
-    impl->id_w     = Hash::str_to_id( "w" );
-    impl->id_h     = Hash::str_to_id( "h" );
-    impl->id_d     = Hash::str_to_id( "d" );
-    impl->id_index = Hash::str_to_id( "index" );
+    impl->prop_line       = nProp( Hash::id_line );
+    impl->prop_kind       = nProp( Hash::id_kind );
+    impl->prop_index      = nProp( Hash::id_index );
+    impl->prop_shape      = nProp( Hash::id_shape );
+    impl->prop_shape_kind = nProp( Hash::id_kind );
+    impl->prop_color      = nProp( Hash::id_color );
+    impl->prop_x          = nProp( Hash::id_x );
+    impl->prop_y          = nProp( Hash::id_y );
+    impl->prop_z          = nProp( Hash::id_z );
+    impl->prop_w          = nProp( Hash::id_w );
+    impl->prop_h          = nProp( Hash::id_h );
+    impl->prop_d          = nProp( Hash::id_d );
+
+    impl->str_geom        = Hash::str_pooled( "geom" );
+    impl->str_box         = Hash::str_pooled( "box" );
+    impl->str_hide        = Hash::str_pooled( "hide" );
+    impl->str_unhide      = Hash::str_pooled( "unhide" );
 
     //----------------------------------------------------------------
     // Prep the visualization.
@@ -124,20 +138,20 @@ Viz::Viz( ConfigViz * config, Sys * sys )
     {
         //if ( (i % 1000) == 0 ) printf( "%d\n", i );
         Hash * obj = impl->viz_list->hp( i );
-        nStr kind = obj->s( impl->id_kind );
+        nStr kind = obj->s( impl->prop_kind );
         bool is_visible = i <= impl->viz_last;
-        if ( strcmp( kind, "geom" ) == 0 ) {
+        if ( kind == impl->str_geom ) {
             // shape
-            Hash * shape = obj->hp( impl->id_shape ); 
-            nStr shape_kind = shape->s( impl->id_kind );
-            if ( strcmp( shape_kind, "box" ) == 0 ) {
-                nFlt x = shape->f( impl->id_x );
-                nFlt y = shape->f( impl->id_y );
-                nFlt z = shape->f( impl->id_z );
-                nFlt w = shape->f( impl->id_w );
-                nFlt h = shape->f( impl->id_h );
-                nFlt d = shape->f( impl->id_d );
-                nStr color_str = shape->s( impl->id_color );
+            Hash * shape = obj->hp( impl->prop_shape ); 
+            nStr shape_kind = shape->s( impl->prop_shape_kind );
+            if ( shape_kind == impl->str_box ) {
+                nFlt x = shape->f( impl->prop_x );
+                nFlt y = shape->f( impl->prop_y );
+                nFlt z = shape->f( impl->prop_z );
+                nFlt w = shape->f( impl->prop_w );
+                nFlt h = shape->f( impl->prop_h );
+                nFlt d = shape->f( impl->prop_d );
+                nStr color_str = shape->s( impl->prop_color );
                 int texid = Color::rgb( color_str );
                 impl->viz_entities[i] = new Box( 0, this, true, x, y, z, w, h, d, texid, texid, texid );
                 impl->viz_entities[i]->visible_set( is_visible );
@@ -145,16 +159,16 @@ Viz::Viz( ConfigViz * config, Sys * sys )
                 printf( "ERROR: unknown shape kind '%s'\n", shape_kind );
                 my_exit( 1 );
             }
-        } else if ( strcmp( kind, "hide" ) == 0 ) {
+        } else if ( kind == impl->str_hide ) {
             // hide existing shape
             //
-            int index = obj->i( impl->id_index );
+            int index = obj->i( impl->prop_index );
             dassert( impl->viz_entities[index] != NULL );
             impl->viz_entities[index]->visible_set( false );
-        } else if ( strcmp( kind, "unhide" ) == 0 ) {
+        } else if ( kind == impl->str_unhide ) {
             // unhide existing shape
             //
-            int index = obj->i( impl->id_index );
+            int index = obj->i( impl->prop_index );
             dassert( impl->viz_entities[index] != NULL );
             impl->viz_entities[index]->visible_set( true );
         } else {
@@ -171,6 +185,9 @@ Viz::~Viz()
 {
     delete impl->viz_nodeio;
     impl->viz_nodeio = nullptr;
+    delete impl->viz_arena;                 // frees viz_list and everything under it
+    impl->viz_arena = nullptr;
+    impl->viz_list = nullptr;
     delete impl;
     impl = nullptr;
 }
@@ -281,12 +298,12 @@ void Viz::key_event( int key, int action, int modifiers )
                     if ( entity != NULL ) {
                         entity->visible_set( true );
                     } else {
-                        int index = obj->i( impl->id_index );
+                        int index = obj->i( impl->prop_index );
                         entity = impl->viz_entities[index];
-                        bool is_hide = strcmp( obj->s( impl->id_kind ), "hide" ) == 0;
+                        bool is_hide = obj->s( impl->prop_kind ) == impl->str_hide;
                         entity->visible_set( !is_hide );
                     }
-                    //printf( "%s\n", obj->s( impl->id_line ) );
+                    //printf( "%s\n", obj->s( impl->prop_line ) );
                 }
                 break;
             }
@@ -306,19 +323,19 @@ void Viz::key_event( int key, int action, int modifiers )
                     if ( entity != NULL ) {
                         entity->visible_set( false );
                     } else {
-                        int index = obj->i( impl->id_index );
+                        int index = obj->i( impl->prop_index );
                         entity = impl->viz_entities[index];
-                        bool is_hide = strcmp( obj->s( impl->id_kind ), "hide" ) == 0;
+                        bool is_hide = obj->s( impl->prop_kind ) == impl->str_hide;
                         entity->visible_set( is_hide );
                     }
                     impl->viz_last -= 1;
-                    //printf( "%s\n", obj->s( impl->id_line ) );
+                    //printf( "%s\n", obj->s( impl->prop_line ) );
                 }
                 break;
             }
 
         case '.':
-            printf( "%s\n", impl->viz_list->hp( impl->viz_last )->s( impl->id_line ) );
+            printf( "%s\n", impl->viz_list->hp( impl->viz_last )->s( impl->prop_line ) );
             break;
 
         default: